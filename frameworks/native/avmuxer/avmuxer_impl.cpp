@@ -25,6 +25,20 @@
 
 namespace {
     constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "AVMuxerImpl"};
+    constexpr uint32_t INPUT_BUFFER_POOL_MAX_CNT = 16;
+    constexpr int32_t INPUT_BUFFER_MIN_SIZE = 4 * 1024;
+    constexpr int32_t INPUT_BUFFER_MAX_ALIGNED_SIZE = 64 * 1024 * 1024;
+
+    int32_t AlignInputBufferSize(int32_t size)
+    {
+        // ashmem pages are only committed when touched, so rounding up to a power of two costs address
+        // space rather than memory, and lets one pooled buffer serve samples of varying sizes.
+        int32_t aligned = INPUT_BUFFER_MIN_SIZE;
+        while (aligned < size && aligned < INPUT_BUFFER_MAX_ALIGNED_SIZE) {
+            aligned <<= 1;
+        }
+        return aligned < size ? size : aligned;
+    }
 }
 
 namespace OHOS {
@@ -51,6 +65,14 @@ AVMuxerImpl::AVMuxerImpl(int32_t fd, OutputFormat format) : fd_(fd), format_(for
 
 AVMuxerImpl::~AVMuxerImpl()
 {
+    {
+        std::lock_guard<std::mutex> lock(inputMutex_);
+        inputBuffers_.clear();
+    }
+    if (inputBufferPool_ != nullptr) {
+        inputBufferPool_->Reset();
+        inputBufferPool_ = nullptr;
+    }
     if (muxerService_ != nullptr) {
         (void)muxerService_->Release();
         (void)AVCodecServiceFactory::GetInstance().DestroyMuxerService(muxerService_);
@@ -65,9 +87,35 @@ int32_t AVMuxerImpl::Init()
     AVCODEC_LOGI("Init");
     muxerService_ = AVCodecServiceFactory::GetInstance().CreateMuxerService();
     CHECK_AND_RETURN_RET_LOG(muxerService_ != nullptr, AVCS_ERR_NO_MEMORY, "Create AVMuxer Service failed");
+    int32_t ret = InitInputBufferPool();
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Init input buffer pool failed");
     return muxerService_->InitParameter(fd_, format_);
 }
 
+int32_t AVMuxerImpl::InitInputBufferPool()
+{
+    inputBufferPool_ = std::make_shared<AVSharedMemoryPool>("muxerInputBuffer");
+    AVSharedMemoryPool::InitializeOption option = {
+        .preAllocMemCnt = 0,
+        .memSize = 0,
+        .maxMemCnt = INPUT_BUFFER_POOL_MAX_CNT,
+        .flags = AVSharedMemory::FLAGS_READ_ONLY,
+        .enableFixedSize = false,
+    };
+    return inputBufferPool_->Init(option);
+}
+
+std::shared_ptr<AVSharedMemory> AVMuxerImpl::AcquireInputBuffer(int32_t size)
+{
+    std::shared_ptr<AVSharedMemory> buffer = inputBufferPool_->AcquireMemory(AlignInputBufferSize(size), false);
+    if (buffer != nullptr) {
+        return buffer;
+    }
+    // every pooled buffer is still held by the service, fall back to a one-off memory instead of blocking.
+    AVCODEC_LOGD("input buffer pool exhausted, allocate a temporary buffer of size %{public}d", size);
+    return AVSharedMemoryBase::CreateFromLocal(size, AVSharedMemory::FLAGS_READ_ONLY, "sampleBuffer");
+}
+
 int32_t AVMuxerImpl::SetLocation(float latitude, float longitude)
 {
     AVCodecTrace trace("AVMuxer::SetLocation");
@@ -84,6 +132,23 @@ int32_t AVMuxerImpl::SetRotation(int32_t rotation)
     return muxerService_->SetRotation(rotation);
 }
 
+int32_t AVMuxerImpl::SetParameter(const MediaDescription &param)
+{
+    AVCodecTrace trace("AVMuxer::SetParameter");
+    AVCODEC_LOGI("SetParameter");
+    CHECK_AND_RETURN_RET_LOG(muxerService_ != nullptr, AVCS_ERR_INVALID_OPERATION, "AVMuxer Service does not exist");
+    return muxerService_->SetParameter(param);
+}
+
+int32_t AVMuxerImpl::SetCallback(const std::shared_ptr<AVMuxerCallback> &callback)
+{
+    AVCodecTrace trace("AVMuxer::SetCallback");
+    AVCODEC_LOGI("SetCallback");
+    CHECK_AND_RETURN_RET_LOG(muxerService_ != nullptr, AVCS_ERR_INVALID_OPERATION, "AVMuxer Service does not exist");
+    CHECK_AND_RETURN_RET_LOG(callback != nullptr, AVCS_ERR_INVALID_VAL, "Callback is nullptr");
+    return muxerService_->SetCallback(callback);
+}
+
 int32_t AVMuxerImpl::AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc)
 {
     AVCodecTrace trace("AVMuxer::AddTrack");
@@ -106,16 +171,58 @@ int32_t AVMuxerImpl::WriteSampleBuffer(uint8_t *sampleBuffer, const TrackSampleI
     CHECK_AND_RETURN_RET_LOG(muxerService_ != nullptr, AVCS_ERR_INVALID_OPERATION, "AVMuxer Service does not exist");
     CHECK_AND_RETURN_RET_LOG(sampleBuffer != nullptr && info.timeUs >= 0, AVCS_ERR_INVALID_VAL, "Invalid memory");
 
-    std::shared_ptr<AVSharedMemoryBase> sharedSampleBuffer =
-        std::make_shared<AVSharedMemoryBase>(info.size, AVSharedMemory::FLAGS_READ_ONLY, "sampleBuffer");
-    int32_t ret = sharedSampleBuffer->Init();
-    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, AVCS_ERR_NO_MEMORY, "create AVSharedMemoryBase failed");
+    CHECK_AND_RETURN_RET_LOG(info.size > 0 && info.size <= INT32_MAX, AVCS_ERR_INVALID_VAL, "Invalid sample size");
+
+    std::shared_ptr<AVSharedMemory> sharedSampleBuffer = AcquireInputBuffer(static_cast<int32_t>(info.size));
+    CHECK_AND_RETURN_RET_LOG(sharedSampleBuffer != nullptr, AVCS_ERR_NO_MEMORY, "Acquire input buffer failed");
     errno_t rc = memcpy_s(sharedSampleBuffer->GetBase(), sharedSampleBuffer->GetSize(), sampleBuffer, info.size);
     CHECK_AND_RETURN_RET_LOG(rc == EOK, AVCS_ERR_UNKNOWN, "memcpy_s failed");
 
     return muxerService_->WriteSampleBuffer(sharedSampleBuffer, info);
 }
 
+std::shared_ptr<AVSharedMemory> AVMuxerImpl::RequestInputBuffer(int32_t size, uint32_t &index)
+{
+    AVCodecTrace trace("AVMuxer::RequestInputBuffer");
+    CHECK_AND_RETURN_RET_LOG(muxerService_ != nullptr, nullptr, "AVMuxer Service does not exist");
+    CHECK_AND_RETURN_RET_LOG(size > 0, nullptr, "Invalid buffer size %{public}d", size);
+
+    std::shared_ptr<AVSharedMemory> buffer = AcquireInputBuffer(size);
+    CHECK_AND_RETURN_RET_LOG(buffer != nullptr, nullptr, "Acquire input buffer failed");
+
+    std::lock_guard<std::mutex> lock(inputMutex_);
+    index = nextInputIndex_++;
+    inputBuffers_[index] = buffer;
+    return buffer;
+}
+
+int32_t AVMuxerImpl::QueueInputBuffer(uint32_t index, const TrackSampleInfo &info)
+{
+    AVCodecTrace trace("AVMuxer::QueueInputBuffer");
+    CHECK_AND_RETURN_RET_LOG(muxerService_ != nullptr, AVCS_ERR_INVALID_OPERATION, "AVMuxer Service does not exist");
+
+    std::shared_ptr<AVSharedMemory> buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(inputMutex_);
+        auto iter = inputBuffers_.find(index);
+        CHECK_AND_RETURN_RET_LOG(iter != inputBuffers_.end(), AVCS_ERR_INVALID_VAL,
+            "Input buffer %{public}u is not requested or already queued", index);
+        buffer = iter->second;
+    }
+    CHECK_AND_RETURN_RET_LOG(info.timeUs >= 0 && info.size > 0 && info.size <= static_cast<uint32_t>(buffer->GetSize()),
+        AVCS_ERR_INVALID_VAL, "Invalid sample info, size %{public}u, buffer size %{public}d",
+        info.size, buffer->GetSize());
+
+    int32_t ret = muxerService_->WriteSampleBuffer(buffer, info);
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Queue input buffer %{public}u failed, it can be queued again",
+        index);
+    // the buffer stays requested until the service takes it, so a rejected one, such as AVCS_ERR_AGAIN of the
+    // non-blocking mode, can be queued again.
+    std::lock_guard<std::mutex> lock(inputMutex_);
+    inputBuffers_.erase(index);
+    return ret;
+}
+
 int32_t AVMuxerImpl::Stop()
 {
     AVCodecTrace trace("AVMuxer::Stop");
@@ -123,5 +230,17 @@ int32_t AVMuxerImpl::Stop()
     CHECK_AND_RETURN_RET_LOG(muxerService_ != nullptr, AVCS_ERR_INVALID_OPERATION, "AVMuxer Service does not exist");
     return muxerService_->Stop();
 }
+
+int32_t AVMuxerImpl::SetNextOutputFile(int32_t fd)
+{
+    AVCodecTrace trace("AVMuxer::SetNextOutputFile");
+    AVCODEC_LOGI("SetNextOutputFile");
+    CHECK_AND_RETURN_RET_LOG(muxerService_ != nullptr, AVCS_ERR_INVALID_OPERATION, "AVMuxer Service does not exist");
+    CHECK_AND_RETURN_RET_LOG(fd >= 0, AVCS_ERR_INVALID_VAL, "Invalid fd %{public}d", fd);
+    CHECK_AND_RETURN_RET_LOG((fcntl(fd, F_GETFL, 0) & O_RDWR) == O_RDWR, AVCS_ERR_INVALID_VAL,
+        "No permission to read and write fd");
+    CHECK_AND_RETURN_RET_LOG(lseek(fd, 0, SEEK_CUR) != -1, AVCS_ERR_INVALID_VAL, "The fd is not seekable");
+    return muxerService_->SetNextOutputFile(fd);
+}
 } // namespace Media
 } // namespace OHOS
\ No newline at end of file
@@ -15,8 +15,11 @@
 #ifndef AVMUXER_IMPL_H
 #define AVMUXER_IMPL_H
 
+#include <map>
+#include <mutex>
 #include "avmuxer.h"
 #include "i_muxer_service.h"
+#include "avsharedmemorypool.h"
 #include "nocopyable.h"
 
 namespace OHOS {
@@ -28,15 +31,27 @@ public:
     int32_t Init();
     int32_t SetLocation(float latitude, float longitude) override;
     int32_t SetRotation(int32_t rotation) override;
+    int32_t SetParameter(const MediaDescription &param) override;
+    int32_t SetCallback(const std::shared_ptr<AVMuxerCallback> &callback) override;
     int32_t AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc) override;
     int32_t Start() override;
     int32_t WriteSampleBuffer(uint8_t *sampleBuffer, const TrackSampleInfo &info) override;
+    std::shared_ptr<AVSharedMemory> RequestInputBuffer(int32_t size, uint32_t &index) override;
+    int32_t QueueInputBuffer(uint32_t index, const TrackSampleInfo &info) override;
     int32_t Stop() override;
+    int32_t SetNextOutputFile(int32_t fd) override;
 
 private:
+    int32_t InitInputBufferPool();
+    std::shared_ptr<AVSharedMemory> AcquireInputBuffer(int32_t size);
+
     std::shared_ptr<IMuxerService> muxerService_ = nullptr;
     int32_t fd_ = -1;
     OutputFormat format_ = OUTPUT_FORMAT_DEFAULT;
+    std::shared_ptr<AVSharedMemoryPool> inputBufferPool_ = nullptr;
+    std::map<uint32_t, std::shared_ptr<AVSharedMemory>> inputBuffers_;
+    uint32_t nextInputIndex_ = 0;
+    std::mutex inputMutex_;
 };
 } // namespace Media
 } // namespace OHOS
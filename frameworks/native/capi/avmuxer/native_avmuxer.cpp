@@ -124,6 +124,32 @@ OH_AVErrCode OH_AVMuxer_WriteSampleBuffer(OH_AVMuxer *muxer,
     return AV_ERR_OK;
 }
 
+OH_AVErrCode OH_AVMuxer_WriteSampleBufferWithDts(OH_AVMuxer *muxer,
+                                                 uint32_t trackIndex,
+                                                 uint8_t *sampleBuffer,
+                                                 OH_AVCodecBufferAttr info,
+                                                 int64_t dts)
+{
+    CHECK_AND_RETURN_RET_LOG(muxer != nullptr, AV_ERR_INVALID_VAL, "input muxer is nullptr!");
+    CHECK_AND_RETURN_RET_LOG(muxer->magic_ == AVMagic::AVCODEC_MAGIC_AVMUXER, AV_ERR_INVALID_VAL, "magic error!");
+    CHECK_AND_RETURN_RET_LOG(dts <= info.pts, AV_ERR_INVALID_VAL, "dts is later than pts!");
+
+    struct AVMuxerObject *object = reinterpret_cast<AVMuxerObject *>(muxer);
+    CHECK_AND_RETURN_RET_LOG(object->muxer_ != nullptr, AV_ERR_INVALID_VAL, "muxer_ is nullptr!");
+
+    TrackSampleInfo sampleInfo;
+    sampleInfo.trackIndex = trackIndex;
+    sampleInfo.timeUs = info.pts;
+    sampleInfo.decodeTimeUs = dts;
+    sampleInfo.size = info.size;
+    sampleInfo.flags = info.flags;
+
+    int32_t ret = object->muxer_->WriteSampleBuffer(sampleBuffer, sampleInfo);
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, AV_ERR_OPERATE_NOT_PERMIT, "muxer_ WriteSampleBuffer failed!");
+
+    return AV_ERR_OK;
+}
+
 OH_AVErrCode OH_AVMuxer_Stop(OH_AVMuxer *muxer)
 {
     CHECK_AND_RETURN_RET_LOG(muxer != nullptr, AV_ERR_INVALID_VAL, "input muxer is nullptr!");
@@ -62,6 +62,7 @@ const std::map<AVCodecServiceErrCode, std::string> AVCS_ERRCODE_INFOS = {
     {AVCS_ERR_SEEK_FAILED,                           "audio or video seek failed"},
     {AVCS_ERR_NETWORK_TIMEOUT,                       "network timeout"},
     {AVCS_ERR_NOT_FIND_CONTAINER,                    "not find a demuxer"},
+    {AVCS_ERR_AGAIN,                                 "try again later"},
     {AVCS_ERR_EXTEND_START,                          "extend start error code"},
 };
 
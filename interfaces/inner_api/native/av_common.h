@@ -17,6 +17,7 @@
 
 #include <vector>
 #include <string>
+#include <climits>
 #include "format.h"
 
 namespace OHOS {
@@ -159,6 +160,11 @@ enum OutputFormat : uint32_t {
     OUTPUT_FORMAT_M4A = 6,
 };
 
+/**
+ * @brief The value of {@link TrackSampleInfo::decodeTimeUs} when the sample has no explicit decode timestamp.
+ */
+constexpr int64_t SAMPLE_TIME_NONE = INT64_MIN;
+
 /**
  * @brief Description information of a sample associated a media track.
  *
@@ -183,6 +189,11 @@ struct TrackSampleInfo {
      * maybe be a combination of multiple {@link AVCodecBufferFlag}.
      */
     uint32_t flags;
+    /**
+     * @brief the decode timestamp in microseconds, it must not be later than timeUs. The default value
+     * {@link SAMPLE_TIME_NONE} means the sample is decoded at its presentation time.
+     */
+    int64_t decodeTimeUs = SAMPLE_TIME_NONE;
 };
 } // namespace Media
 } // namespace OHOS
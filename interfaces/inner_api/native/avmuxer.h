@@ -17,19 +17,62 @@
 #define AVMUXER_H
 
 #include "media_description.h"
+#include "avsharedmemory.h"
 #include "av_common.h"
 
 namespace OHOS {
 namespace Media {
+class AVMuxerCallback {
+public:
+    virtual ~AVMuxerCallback() = default;
+    /**
+     * Called when an error occurred after the call returned, such as a sample submitted asynchronously
+     * failed to be written into the file.
+     *
+     * @param errorCode Error code, refer to {@AVCodecServiceErrCode}.
+     */
+    virtual void OnError(int32_t errorCode) = 0;
+
+    /**
+     * Called when the muxer queue has drained below the low watermark after a non-blocking
+     * WriteSampleBuffer returned AVCS_ERR_AGAIN. It is called once for each such rejection period.
+     */
+    virtual void OnSpaceAvailable() {}
+    /**
+     * Called when the output has switched to the file set by SetNextOutputFile. The previous file is complete
+     * when it is called, so the next file for the following rollover can be set from here.
+     *
+     * @param startTimeUs The time of the first sample written into the new file, in microseconds.
+     */
+    virtual void OnOutputFileSwitched(int64_t startTimeUs)
+    {
+        (void)startTimeUs;
+    }
+};
+
 class AVMuxer {
 public:
     virtual ~AVMuxer() = default;
     virtual int32_t SetLocation(float latitude, float longitude) = 0;
     virtual int32_t SetRotation(int32_t rotation) = 0;
+    virtual int32_t SetParameter(const MediaDescription &param) = 0;
+    virtual int32_t SetCallback(const std::shared_ptr<AVMuxerCallback> &callback) = 0;
     virtual int32_t AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc) = 0;
     virtual int32_t Start() = 0;
     virtual int32_t WriteSampleBuffer(uint8_t *sampleBuffer, const TrackSampleInfo &info) = 0;
+    virtual std::shared_ptr<AVSharedMemory> RequestInputBuffer(int32_t size, uint32_t &index) = 0;
+    virtual int32_t QueueInputBuffer(uint32_t index, const TrackSampleInfo &info) = 0;
     virtual int32_t Stop() = 0;
+    /**
+     * Set the file the output rolls over to, without stopping the muxer. The previous file is finished and
+     * the new one started at the next sync frame of the video track, once the segment limits set by
+     * MD_KEY_MUXER_MAX_SEGMENT_DURATION or MD_KEY_MUXER_MAX_SEGMENT_SIZE are reached, or at once if none
+     * is set. The tracks, the parameters and the queue are kept. The muxer takes a duplicate of the fd.
+     *
+     * @param fd The file descriptor of the next output file, opened for reading and writing.
+     * @return Returns AVCS_ERR_OK if the file is accepted, otherwise returns an error code.
+     */
+    virtual int32_t SetNextOutputFile(int32_t fd) = 0;
 };
 
 class __attribute__((visibility("default"))) AVMuxerFactory {
@@ -127,6 +127,122 @@ public:
     */
     static constexpr std::string_view MD_KEY_CODEC_CONFIG = "codec_config";
 
+    /**
+     * Key for the max time in microseconds a small sample may be held by the muxer client to be sent together
+     * with the following samples in one transaction, 0 disables the batching, value type is int64_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_BATCH_LATENCY = "muxer_batch_latency";
+
+    /**
+     * Key for submitting the samples to the muxer service without waiting for the result, the errors are
+     * reported through AVMuxerCallback::OnError, value type is boolean
+     */
+    static constexpr std::string_view MD_KEY_MUXER_ASYNC_WRITE = "muxer_async_write";
+
+    /**
+     * Key for the bytes of samples the muxer may hold before WriteSampleBuffer is blocked, value type is int64_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_QUEUE_HIGH_WATERMARK = "muxer_queue_high_watermark";
+
+    /**
+     * Key for the bytes of samples the muxer queue has to drain to before a blocked WriteSampleBuffer
+     * is resumed, must not be larger than the high watermark, value type is int64_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_QUEUE_LOW_WATERMARK = "muxer_queue_low_watermark";
+
+    /**
+     * Key for the max count of samples the muxer may hold before WriteSampleBuffer is blocked, value type is int32_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_QUEUE_MAX_SAMPLES = "muxer_queue_max_samples";
+
+    /**
+     * Key for returning AVCS_ERR_AGAIN from WriteSampleBuffer instead of blocking when the muxer queue is full,
+     * AVMuxerCallback::OnSpaceAvailable is called once the queue drains below the low watermark,
+     * value type is boolean
+     */
+    static constexpr std::string_view MD_KEY_MUXER_NON_BLOCKING = "muxer_non_blocking";
+
+    /**
+     * Key for the time window in microseconds the muxer may hold the samples of each track to write the
+     * samples of all tracks in timestamp order, 0 writes the samples in arrival order, value type is int64_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_INTERLEAVE_WINDOW = "muxer_interleave_window";
+
+    /**
+     * Key for writing a fragmented MP4, the value is the target duration in microseconds of each fragment,
+     * 0 writes a regular MP4 with the moov at the front, value type is int64_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_FRAGMENT_DURATION = "muxer_fragment_duration";
+
+    /**
+     * Key for the expected duration in microseconds of the output. When it is set, the space of the moov is
+     * reserved at the head of the file from the duration, the frame rate and the bitrate of the tracks, so that
+     * Stop() writes the moov in place instead of moving the whole file. It may also be given in the description
+     * of a track, which then overrides the muxer value for that track. Value type is int64_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_EXPECTED_DURATION = "muxer_expected_duration";
+
+    /**
+     * Key for the bytes reserved for the moov at the head of the file, it overrides the size estimated from
+     * MD_KEY_MUXER_EXPECTED_DURATION, value type is int64_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_MOOV_SIZE = "muxer_moov_size";
+
+    /**
+     * Key for the expected size in bytes of the output. When it or MD_KEY_MUXER_EXPECTED_DURATION is set, the
+     * storage of the file is allocated in chunks ahead of the writing, and the unused tail is released by Stop().
+     * Value type is int64_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_EXPECTED_SIZE = "muxer_expected_size";
+
+    /**
+     * Key for the bytes the muxer buffers before writing them to the file, it is rounded up to the block size
+     * of the file system, value type is int32_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_IO_BUFFER_SIZE = "muxer_io_buffer_size";
+
+    /**
+     * Key for the size in bytes from which a sample is written to the file straight from its memory instead of
+     * being copied through the io buffer, 0 copies all samples, value type is int32_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_DIRECT_WRITE_THRESHOLD = "muxer_direct_write_threshold";
+
+    /**
+     * Key to write the output file asynchronously through io_uring, the synchronous writes are used when
+     * the system does not support it, value type is int32_t (0 or 1)
+     */
+    static constexpr std::string_view MD_KEY_MUXER_ASYNC_IO = "muxer_async_io";
+
+    /**
+     * Key for the number of io buffers written to the file by a dedicated thread behind the muxing,
+     * 0, the default, writes the file on the muxing thread, value type is int32_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_WRITE_BEHIND_BUFFERS = "muxer_write_behind_buffers";
+
+    /**
+     * Key for the bytes after which the written output is sent to the storage, so that little dirty page cache
+     * is left for Stop() and a later fsync, 0 leaves it to the system, value type is int64_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_WRITEBACK_INTERVAL = "muxer_writeback_interval";
+
+    /**
+     * Key to write the output with direct io, bypassing the page cache, for long recordings that are not read
+     * back soon. The io buffer size is rounded up to the page size. Value type is int32_t (0 or 1)
+     */
+    static constexpr std::string_view MD_KEY_MUXER_DIRECT_IO = "muxer_direct_io";
+
+    /**
+     * Key for the duration in microseconds after which the output rolls over to the file set by
+     * AVMuxer::SetNextOutputFile, at the next sync frame, value type is int64_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_MAX_SEGMENT_DURATION = "muxer_max_segment_duration";
+
+    /**
+     * Key for the sample bytes after which the output rolls over to the file set by AVMuxer::SetNextOutputFile,
+     * at the next sync frame, value type is int64_t
+     */
+    static constexpr std::string_view MD_KEY_MUXER_MAX_SEGMENT_SIZE = "muxer_max_segment_size";
+
 private:
     MediaDescriptionKey() = delete;
     ~MediaDescriptionKey() = delete;
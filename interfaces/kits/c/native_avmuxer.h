@@ -117,6 +117,29 @@ OH_AVErrCode OH_AVMuxer_WriteSampleBuffer(OH_AVMuxer *muxer,
                                           uint8_t *sampleBuffer,
                                           OH_AVCodecBufferAttr info);
 
+/**
+ * @brief Write an encoded sample with an explicit decode timestamp to the muxer, it is required for the
+ * video streams with B-frames, whose decode order differs from the presentation order.
+ * Note: This interface can only be called after OH_AVMuxer_Start and before OH_AVMuxer_Stop. The samples for each
+ * track need to be written in decode order.
+ * @syscap SystemCapability.Multimedia.Media.Muxer
+ * @param muxer Pointer to an OH_AVMuxer instance
+ * @param trackIndex The track index for this sample
+ * @param sampleBuffer The encoded sample buffer
+ * @param info The buffer information related to this sample {@link OH_AVCodecBufferAttr}, info.pts is the
+ * presentation timestamp
+ * @param dts The decode timestamp of this sample in microseconds, it must not be later than info.pts
+ * @return Returns AV_ERR_OK if the execution is successful,
+ * otherwise returns a specific error code, refer to {@link OH_AVErrCode}
+ * @since 11
+ * @version 1.0
+ */
+OH_AVErrCode OH_AVMuxer_WriteSampleBufferWithDts(OH_AVMuxer *muxer,
+                                                 uint32_t trackIndex,
+                                                 uint8_t *sampleBuffer,
+                                                 OH_AVCodecBufferAttr info,
+                                                 int64_t dts);
+
 /**
  * @brief Stop the muxer.
  * Note: Once the muxer stops, it can not be restarted.
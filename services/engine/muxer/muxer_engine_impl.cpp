@@ -15,6 +15,8 @@
 
 #include "muxer_engine_impl.h"
 #include <set>
+#include <algorithm>
+#include <chrono>
 #include <fcntl.h>
 #include <unistd.h>
 #include "securec.h"
@@ -31,6 +33,9 @@ namespace {
     constexpr int32_t MAX_LONGITUDE = 180;
     constexpr int32_t MIN_LONGITUDE = -180;
     constexpr int32_t ERR_TRACK_INDEX = -1;
+    constexpr int64_t DEFAULT_QUEUE_HIGH_WATERMARK = 8 * 1024 * 1024;
+    constexpr int32_t DEFAULT_QUEUE_MAX_SAMPLES = 128;
+    constexpr int32_t MAX_QUEUE_MAX_SAMPLES = 4096;
 }
 
 namespace OHOS {
@@ -65,11 +70,13 @@ std::shared_ptr<IMuxerEngine> IMuxerEngineFactory::CreateMuxerEngine(
 }
 
 MuxerEngineImpl::MuxerEngineImpl(int32_t appUid, int32_t appPid, int32_t fd, OutputFormat format)
-    : appUid_(appUid), appPid_(appPid), fd_(fd), format_(format), que_("muxer_write_queue")
+    : appUid_(appUid), appPid_(appPid), fd_(fd), format_(format),
+      que_("muxer_write_queue", DEFAULT_QUEUE_MAX_SAMPLES)
 {
     format_ = (format_ == OUTPUT_FORMAT_DEFAULT) ? OUTPUT_FORMAT_MPEG_4 : format_;
     AVCodecTrace trace("MuxerEngine::Create");
     AVCODEC_LOGI("0x%{public}06" PRIXPTR " Instances create", FAKE_POINTER(this));
+    (void)ParseQueueBudget(parameters_);
     muxer_ = Plugin::MuxerFactory::Instance().CreatePlugin(fd_, format_);
     if (muxer_ != nullptr && fd_ >= 0) {
         state_ = State::INITIALIZED;
@@ -86,8 +93,10 @@ MuxerEngineImpl::~MuxerEngineImpl()
     if (state_ == State::STARTED) {
         que_.SetActive(false);
         StopThread();
+        ClearInterleaver();
     }
 
+    CloseNextOutputFile();
     appUid_ = -1;
     appPid_ = -1;
     muxer_ = nullptr;
@@ -111,7 +120,14 @@ int32_t MuxerEngineImpl::SetLocation(float latitude, float longitude)
         return AVCS_ERR_INVALID_VAL;
     }
 
-    return TranslatePluginStatus(muxer_->SetLocation(latitude, longitude));
+    Plugin::Status ret = muxer_->SetLocation(latitude, longitude);
+    if (ret == Plugin::Status::NO_ERROR) {
+        // kept for a plugin that takes over in SetParameter.
+        hasLocation_ = true;
+        latitude_ = latitude;
+        longitude_ = longitude;
+    }
+    return TranslatePluginStatus(ret);
 }
 
 int32_t MuxerEngineImpl::SetRotation(int32_t rotation)
@@ -128,7 +144,143 @@ int32_t MuxerEngineImpl::SetRotation(int32_t rotation)
         return AVCS_ERR_INVALID_VAL;
     }
 
-    return TranslatePluginStatus(muxer_->SetRotation(rotation));
+    Plugin::Status ret = muxer_->SetRotation(rotation);
+    if (ret == Plugin::Status::NO_ERROR) {
+        rotation_ = rotation;
+    }
+    return TranslatePluginStatus(ret);
+}
+
+int32_t MuxerEngineImpl::SetParameter(const MediaDescription &param)
+{
+    AVCodecTrace trace("MuxerEngine::SetParameter");
+    AVCODEC_LOGI("SetParameter");
+    std::unique_lock<std::mutex> lock(mutex_);
+    CHECK_AND_RETURN_RET_LOG(state_ == State::INITIALIZED, AVCS_ERR_INVALID_OPERATION,
+        "The state is not INITIALIZED, the interface must be called after constructor and before Start(). "
+        "The current state is %{public}s", ConvertStateToString(state_).c_str());
+    // a key that is not given keeps the value of an earlier call.
+    MediaDescription merged = parameters_;
+    MergeMediaDescription(merged, param);
+    int32_t ret = ParseQueueBudget(merged);
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Invalid muxer queue budget");
+    int64_t interleaveWindowUs = 0;
+    (void)merged.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_INTERLEAVE_WINDOW, interleaveWindowUs);
+    CHECK_AND_RETURN_RET_LOG(interleaveWindowUs >= 0, AVCS_ERR_INVALID_VAL,
+        "Invalid interleave window %{public}" PRId64, interleaveWindowUs);
+    interleaveWindowUs_ = interleaveWindowUs;
+    ret = ParseSegmentPolicy(merged);
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Invalid segment policy");
+    Plugin::Status pluginRet = muxer_->SetParameter(param);
+    if (pluginRet == Plugin::Status::ERROR_UNIMPLEMENTED && tracks_.empty()) {
+        // the plugin does not write what is asked for, such as a fragmented file, the next one may.
+        pluginRet = ReplacePlugin(merged);
+    }
+    CHECK_AND_RETURN_RET_LOG(pluginRet == Plugin::Status::NO_ERROR, TranslatePluginStatus(pluginRet),
+        "The plugin rejects the parameters");
+    int32_t nonBlocking = 0;
+    (void)merged.GetIntValue(MediaDescriptionKey::MD_KEY_MUXER_NON_BLOCKING, nonBlocking);
+    nonBlocking_ = nonBlocking != 0;
+    // keys unknown to the engine are ignored, so that new keys stay compatible with older services.
+    parameters_ = merged;
+    return AVCS_ERR_OK;
+}
+
+void MuxerEngineImpl::MergeMediaDescription(MediaDescription &dst, const MediaDescription &src)
+{
+    const auto &dataMap = src.GetFormatMap();
+    for (auto it = dataMap.begin(); it != dataMap.end(); ++it) {
+        const std::string &key = it->first;
+        const FormatData &data = it->second;
+        switch (data.type) {
+            case FORMAT_TYPE_INT32:
+                (void)dst.PutIntValue(key, data.val.int32Val);
+                break;
+            case FORMAT_TYPE_INT64:
+                (void)dst.PutLongValue(key, data.val.int64Val);
+                break;
+            case FORMAT_TYPE_FLOAT:
+                (void)dst.PutFloatValue(key, data.val.floatVal);
+                break;
+            case FORMAT_TYPE_DOUBLE:
+                (void)dst.PutDoubleValue(key, data.val.doubleVal);
+                break;
+            case FORMAT_TYPE_STRING:
+                (void)dst.PutStringValue(key, data.stringVal);
+                break;
+            case FORMAT_TYPE_ADDR:
+                (void)dst.PutBuffer(key, data.addr, data.size);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+Plugin::Status MuxerEngineImpl::ReplacePlugin(const MediaDescription &param)
+{
+    std::string current = muxer_->GetName();
+    std::shared_ptr<Plugin::Muxer> muxer = Plugin::MuxerFactory::Instance().CreatePlugin(fd_, format_, current);
+    CHECK_AND_RETURN_RET_LOG(muxer != nullptr, Plugin::Status::ERROR_UNIMPLEMENTED,
+        "No other plugin for output format %{public}d", format_);
+    if (hasLocation_) {
+        (void)muxer->SetLocation(latitude_, longitude_);
+    }
+    if (rotation_ != 0) {
+        (void)muxer->SetRotation(rotation_);
+    }
+    Plugin::Status ret = muxer->SetParameter(param);
+    CHECK_AND_RETURN_RET_LOG(ret == Plugin::Status::NO_ERROR, ret, "The plugin %{public}s rejects the parameters",
+        muxer->GetName().c_str());
+    AVCODEC_LOGI("The plugin %{public}s is replaced by %{public}s", current.c_str(), muxer->GetName().c_str());
+    muxer_ = muxer;
+    return ret;
+}
+
+int32_t MuxerEngineImpl::ParseQueueBudget(const MediaDescription &param)
+{
+    int64_t highWatermark = DEFAULT_QUEUE_HIGH_WATERMARK;
+    int64_t lowWatermark = -1;
+    int32_t maxSamples = DEFAULT_QUEUE_MAX_SAMPLES;
+    param.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_QUEUE_HIGH_WATERMARK, highWatermark);
+    param.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_QUEUE_LOW_WATERMARK, lowWatermark);
+    param.GetIntValue(MediaDescriptionKey::MD_KEY_MUXER_QUEUE_MAX_SAMPLES, maxSamples);
+    lowWatermark = lowWatermark < 0 ? highWatermark / 2 : lowWatermark;
+    CHECK_AND_RETURN_RET_LOG(highWatermark > 0 && lowWatermark <= highWatermark, AVCS_ERR_INVALID_VAL,
+        "The queue watermarks are invalid, high %{public}" PRId64 ", low %{public}" PRId64,
+        highWatermark, lowWatermark);
+    CHECK_AND_RETURN_RET_LOG(maxSamples > 0 && maxSamples <= MAX_QUEUE_MAX_SAMPLES, AVCS_ERR_INVALID_VAL,
+        "The queue max samples %{public}d is out of range (0, %{public}d]", maxSamples, MAX_QUEUE_MAX_SAMPLES);
+    queueHighWatermark_ = highWatermark;
+    queueLowWatermark_ = lowWatermark;
+    queueMaxSamples_ = maxSamples;
+    return AVCS_ERR_OK;
+}
+
+int32_t MuxerEngineImpl::ParseSegmentPolicy(const MediaDescription &param)
+{
+    int64_t maxDurationUs = 0;
+    int64_t maxBytes = 0;
+    (void)param.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_MAX_SEGMENT_DURATION, maxDurationUs);
+    (void)param.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_MAX_SEGMENT_SIZE, maxBytes);
+    CHECK_AND_RETURN_RET_LOG(maxDurationUs >= 0 && maxBytes >= 0, AVCS_ERR_INVALID_VAL,
+        "The segment limits are invalid, duration %{public}" PRId64 ", size %{public}" PRId64,
+        maxDurationUs, maxBytes);
+    segmentMaxDurationUs_ = maxDurationUs;
+    segmentMaxBytes_ = maxBytes;
+    return AVCS_ERR_OK;
+}
+
+int32_t MuxerEngineImpl::SetCallback(const std::shared_ptr<AVMuxerCallback> &callback)
+{
+    AVCodecTrace trace("MuxerEngine::SetCallback");
+    AVCODEC_LOGI("SetCallback");
+    std::unique_lock<std::mutex> lock(mutex_);
+    CHECK_AND_RETURN_RET_LOG(state_ == State::INITIALIZED, AVCS_ERR_INVALID_OPERATION,
+        "The state is not INITIALIZED, the interface must be called after constructor and before Start(). "
+        "The current state is %{public}s", ConvertStateToString(state_).c_str());
+    callback_ = callback;
+    return AVCS_ERR_OK;
 }
 
 int32_t MuxerEngineImpl::AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc)
@@ -172,6 +324,22 @@ int32_t MuxerEngineImpl::Start()
         "The track count is error, count is %{public}d", tracks_.size());
     Plugin::Status ret = muxer_->Start();
     CHECK_AND_RETURN_RET_LOG(ret == Plugin::Status::NO_ERROR, TranslatePluginStatus(ret), "Start failed");
+    que_.Reset(static_cast<size_t>(queueMaxSamples_));
+    queuedBytes_ = 0;
+    queueThrottled_ = false;
+    ClearInterleaver();
+    segmentTrackIndex_ = -1;
+    for (auto &track : tracks_) {
+        // the segments are cut at the sync frames of the video track, any sample starts one without video.
+        if (track.second.find("video") == 0) {
+            segmentTrackIndex_ = track.first;
+            break;
+        }
+    }
+    segmentStartUs_ = -1;
+    segmentBytes_ = 0;
+    segmentLimitWarned_ = false;
+    outputFailed_ = false;
     state_ = State::STARTED;
     StartThread("muxer_write_loop");
 
@@ -187,13 +355,34 @@ int32_t MuxerEngineImpl::WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampl
         "The current state is %{public}s", ConvertStateToString(state_).c_str());
     CHECK_AND_RETURN_RET_LOG(tracks_.find(info.trackIndex) != tracks_.end(), AVCS_ERR_INVALID_VAL,
         "The track index does not exist");
+    CHECK_AND_RETURN_RET_LOG(!outputFailed_, AVCS_ERR_INVALID_OPERATION,
+        "The output failed, the muxer must be stopped");
     CHECK_AND_RETURN_RET_LOG(sampleBuffer != nullptr && info.timeUs >= 0, AVCS_ERR_INVALID_VAL, "Invalid memory");
+    CHECK_AND_RETURN_RET_LOG(info.decodeTimeUs == SAMPLE_TIME_NONE || info.decodeTimeUs <= info.timeUs,
+        AVCS_ERR_INVALID_VAL, "The decode time %{public}" PRId64 " is later than the presentation time %{public}" PRId64,
+        info.decodeTimeUs, info.timeUs);
 
     std::shared_ptr<BlockBuffer> blockBuffer = std::make_shared<BlockBuffer>();
     blockBuffer->buffer_ = sampleBuffer;
     blockBuffer->info_ = info;
-    que_.Push(blockBuffer);
 
+    // only the producers are serialized here, so waiting for the queue does not block Stop() or DumpInfo()
+    std::unique_lock<std::mutex> writeLock(writeMutex_);
+    lock.unlock();
+    if (nonBlocking_) {
+        if (!TryAcquireQueueBudget(info.size)) {
+            AVCODEC_LOGD("The queue is full, try again after OnSpaceAvailable");
+            return AVCS_ERR_AGAIN;
+        }
+    } else if (!AcquireQueueBudget(info.size)) {
+        AVCODEC_LOGE("The muxer is stopped while waiting for the queue");
+        return AVCS_ERR_INVALID_OPERATION;
+    }
+    if (!que_.Push(blockBuffer)) {
+        queuedBytes_ -= info.size;
+        AVCODEC_LOGE("The muxer is stopped while writing the sample");
+        return AVCS_ERR_INVALID_OPERATION;
+    }
     return AVCS_ERR_OK;
 }
 
@@ -210,11 +399,59 @@ int32_t MuxerEngineImpl::Stop()
         "The state is not STARTED. The current state is %{public}s", ConvertStateToString(state_).c_str());
     state_ = State::STOPPED;
     que_.SetActive(false, false);
-    cond_.wait(lock, [this] { return que_.Empty(); });
+    {
+        // a producer waiting for the queue budget holds writeMutex_, release it before taking that lock.
+        std::lock_guard<std::mutex> budgetLock(budgetMutex_);
+        budgetStopping_ = true;
+        budgetCond_.notify_all();
+    }
+    {
+        // a producer blocked on the queue returns once it is inactive, then the queue is drained.
+        std::lock_guard<std::mutex> writeLock(writeMutex_);
+        que_.WaitEmpty();
+    }
     StopThread();
+    // the writer thread is gone, the samples still held for interleaving are written here.
+    std::shared_ptr<BlockBuffer> buffer = nullptr;
+    while ((buffer = PopFromInterleaver(true)) != nullptr) {
+        WriteToPlugin(buffer);
+    }
+    CloseNextOutputFile();
+    // a failed switch has already finished the plugin's file, it must not be finished twice.
+    CHECK_AND_RETURN_RET_LOG(!outputFailed_, AVCS_ERR_UNKNOWN, "The output failed while muxing");
     return TranslatePluginStatus(muxer_->Stop());
 }
 
+int32_t MuxerEngineImpl::SetNextOutputFile(int32_t fd)
+{
+    AVCodecTrace trace("MuxerEngine::SetNextOutputFile");
+    AVCODEC_LOGI("SetNextOutputFile");
+    std::unique_lock<std::mutex> lock(mutex_);
+    CHECK_AND_RETURN_RET_LOG(state_ == State::INITIALIZED || state_ == State::STARTED, AVCS_ERR_INVALID_OPERATION,
+        "The state is not INITIALIZED or STARTED, the interface must be called before Stop(). "
+        "The current state is %{public}s", ConvertStateToString(state_).c_str());
+    CHECK_AND_RETURN_RET_LOG((fcntl(fd, F_GETFL, 0) & O_RDWR) == O_RDWR, AVCS_ERR_INVALID_VAL,
+        "no permission to read and write fd");
+    CHECK_AND_RETURN_RET_LOG(lseek(fd, 0, SEEK_CUR) != -1, AVCS_ERR_INVALID_VAL, "the fd is not seekable");
+    int32_t newFd = dup(fd);
+    CHECK_AND_RETURN_RET_LOG(newFd >= 0, AVCS_ERR_UNKNOWN, "dup fd failed");
+    // the writer thread takes the fd at the next switch point, a file set again before that replaces it.
+    int32_t oldFd = nextOutputFd_.exchange(newFd);
+    if (oldFd >= 0) {
+        AVCODEC_LOGW("The previous next output file is not used, replace it");
+        (void)close(oldFd);
+    }
+    return AVCS_ERR_OK;
+}
+
+void MuxerEngineImpl::CloseNextOutputFile()
+{
+    int32_t fd = nextOutputFd_.exchange(-1);
+    if (fd >= 0) {
+        (void)close(fd);
+    }
+}
+
 int32_t MuxerEngineImpl::DumpInfo(int32_t fd)
 {
     AVCODEC_LOGI("DumpInfo fd:%{public}d", fd);
@@ -222,7 +459,40 @@ int32_t MuxerEngineImpl::DumpInfo(int32_t fd)
     dumpString += "In MuxerEngine::DumpInfo\n";
     dumpString += "Current MuxerEngine state is: " + ConvertStateToString(state_) + "\n";
     dumpString += "Current MuxerEngine output format is: " + std::to_string(format_) + "\n";
-    dumpString += "\nCurrent MuxerEngine media description is:\n";
+    dumpString += "Current MuxerEngine plugin is: " + (muxer_ != nullptr ? muxer_->GetName() : "none") + "\n";
+    dumpString += "Current MuxerEngine queue depth is: " + std::to_string(que_.Size()) + " samples, " +
+        std::to_string(queuedBytes_.load()) + " bytes\n";
+    dumpString += "Current MuxerEngine queue limits are: " + std::to_string(queueMaxSamples_) + " samples, " +
+        "high watermark " + std::to_string(queueHighWatermark_) + " bytes, " +
+        "low watermark " + std::to_string(queueLowWatermark_) + " bytes\n";
+    dumpString += "Current MuxerEngine interleaver holds: " + std::to_string(interleaveSamples_.load()) +
+        " samples, " + std::to_string(interleaveBytes_.load()) + " bytes, window " +
+        std::to_string(interleaveWindowUs_) + " us\n";
+    dumpString += "Current MuxerEngine mux stage wrote: " + std::to_string(muxSamples_.load()) + " samples in " +
+        std::to_string(muxTimeUs_.load()) + " us, max " + std::to_string(muxMaxTimeUs_.load()) + " us\n";
+    dumpString += "Current MuxerEngine output segments: " + std::to_string(segmentCount_.load()) +
+        ", next output file " + (nextOutputFd_ >= 0 ? "set" : "not set") + "\n";
+    dumpString += "\nCurrent MuxerEngine parameters are:\n";
+    if (fd < 0) {
+        AVCODEC_LOGI("%{public}s", dumpString.c_str());
+    } else {
+        write(fd, dumpString.c_str(), dumpString.size());
+    }
+    DumpMediaDescription(fd, parameters_);
+
+    MediaDescription statistics;
+    if (muxer_ != nullptr && muxer_->GetStatistics(statistics) == Plugin::Status::NO_ERROR &&
+        !statistics.GetFormatMap().empty()) {
+        dumpString = "\nCurrent MuxerEngine plugin statistics are:\n";
+        if (fd < 0) {
+            AVCODEC_LOGI("%{public}s", dumpString.c_str());
+        } else {
+            write(fd, dumpString.c_str(), dumpString.size());
+        }
+        DumpMediaDescription(fd, statistics);
+    }
+
+    dumpString = "\nCurrent MuxerEngine media description is:\n";
     if (fd < 0) {
         AVCODEC_LOGI("%{public}s", dumpString.c_str());
     } else {
@@ -335,13 +605,219 @@ void MuxerEngineImpl::ThreadProcessor()
             return;
         }
         auto buffer = que_.Pop();
-        if (buffer != nullptr) {
-            (void)muxer_->WriteSampleBuffer(buffer->buffer_->GetBase(), buffer->info_);
+        if (buffer == nullptr) {
+            continue;
+        }
+        if (interleaveWindowUs_ <= 0) {
+            WriteToPlugin(buffer);
+            continue;
+        }
+        PushToInterleaver(buffer);
+        while ((buffer = PopFromInterleaver(false)) != nullptr) {
+            WriteToPlugin(buffer);
+        }
+    }
+}
+
+void MuxerEngineImpl::WriteToPlugin(const std::shared_ptr<BlockBuffer> &buffer)
+{
+    if (ShouldSwitchOutput(buffer->info_)) {
+        SwitchOutput(buffer->info_);
+    }
+    if (outputFailed_) {
+        // the plugin has no file to write to, the samples left in the queue are dropped.
+        ReleaseQueueBudget(buffer->info_.size);
+        return;
+    }
+    if (segmentStartUs_ < 0) {
+        segmentStartUs_ = buffer->info_.timeUs;
+    }
+    segmentBytes_ += buffer->info_.size;
+    auto begin = std::chrono::steady_clock::now();
+    Plugin::Status ret = muxer_->WriteSampleBuffer(buffer->buffer_->GetBase(), buffer->info_);
+    int64_t costUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - begin).count();
+    muxSamples_++;
+    muxTimeUs_ += costUs;
+    if (costUs > muxMaxTimeUs_) {
+        muxMaxTimeUs_ = costUs;
+    }
+    if (ret != Plugin::Status::NO_ERROR) {
+        AVCODEC_LOGE("Write sample of track %{public}u failed, ret %{public}d",
+            buffer->info_.trackIndex, static_cast<int32_t>(ret));
+        if (callback_ != nullptr) {
+            callback_->OnError(TranslatePluginStatus(ret));
+        }
+    }
+    ReleaseQueueBudget(buffer->info_.size);
+}
+
+bool MuxerEngineImpl::ShouldSwitchOutput(const TrackSampleInfo &info)
+{
+    if (segmentStartUs_ < 0) {
+        return false;
+    }
+    bool switchPoint = segmentTrackIndex_ < 0 || (static_cast<int32_t>(info.trackIndex) == segmentTrackIndex_ &&
+        (info.flags & AVCODEC_BUFFER_FLAG_SYNC_FRAME));
+    if (!switchPoint) {
+        return false;
+    }
+    bool hasLimit = segmentMaxDurationUs_ > 0 || segmentMaxBytes_ > 0;
+    bool limitReached = (segmentMaxDurationUs_ > 0 && info.timeUs - segmentStartUs_ >= segmentMaxDurationUs_) ||
+        (segmentMaxBytes_ > 0 && segmentBytes_ >= segmentMaxBytes_);
+    if (nextOutputFd_ < 0) {
+        if (limitReached && !segmentLimitWarned_) {
+            AVCODEC_LOGW("The segment limit is reached but the next output file is not set, keep writing");
+            segmentLimitWarned_ = true;
+        }
+        return false;
+    }
+    // without a policy the next file is taken at the first switch point after it is set.
+    return !hasLimit || limitReached;
+}
+
+void MuxerEngineImpl::SwitchOutput(const TrackSampleInfo &info)
+{
+    AVCodecTrace trace("MuxerEngine::SwitchOutput");
+    int32_t fd = nextOutputFd_.exchange(-1);
+    if (fd < 0) {
+        return;
+    }
+    AVCODEC_LOGI("Switch the output at %{public}" PRId64 " us, segment %{public}" PRId64 " us, %{public}" PRId64
+        " bytes", info.timeUs, info.timeUs - segmentStartUs_, segmentBytes_);
+    Plugin::Status ret = muxer_->SwitchOutput(fd);
+    (void)close(fd);
+    segmentStartUs_ = -1;
+    segmentBytes_ = 0;
+    segmentLimitWarned_ = false;
+    if (ret != Plugin::Status::NO_ERROR) {
+        AVCODEC_LOGE("Switch the output failed, ret %{public}d", static_cast<int32_t>(ret));
+        outputFailed_ = true;
+        if (callback_ != nullptr) {
+            callback_->OnError(TranslatePluginStatus(ret));
+        }
+        return;
+    }
+    segmentCount_++;
+    if (callback_ != nullptr) {
+        callback_->OnOutputFileSwitched(info.timeUs);
+    }
+}
+
+void MuxerEngineImpl::PushToInterleaver(const std::shared_ptr<BlockBuffer> &buffer)
+{
+    int64_t timeUs = GetInterleaveTime(buffer->info_);
+    interleaveMaxTimeUs_ = interleaveSamples_ == 0 ? timeUs : std::max(interleaveMaxTimeUs_, timeUs);
+    interleaveQueues_[buffer->info_.trackIndex].push_back(buffer);
+    interleaveBytes_ += buffer->info_.size;
+    interleaveSamples_++;
+}
+
+std::shared_ptr<MuxerEngineImpl::BlockBuffer> MuxerEngineImpl::PopFromInterleaver(bool flush)
+{
+    // each track keeps its own order, only the heads of the tracks are compared.
+    std::deque<std::shared_ptr<BlockBuffer>> *earliest = nullptr;
+    bool allTracksQueued = true;
+    for (auto &track : tracks_) {
+        auto it = interleaveQueues_.find(static_cast<uint32_t>(track.first));
+        if (it == interleaveQueues_.end() || it->second.empty()) {
+            allTracksQueued = false;
+            continue;
         }
-        if (que_.Empty()) {
-            cond_.notify_all();
+        if (earliest == nullptr ||
+            GetInterleaveTime(it->second.front()->info_) < GetInterleaveTime(earliest->front()->info_)) {
+            earliest = &it->second;
+        }
+    }
+    if (earliest == nullptr) {
+        return nullptr;
+    }
+    int64_t timeUs = GetInterleaveTime(earliest->front()->info_);
+    // the held bytes are capped by the low watermark, so that a producer waiting for the budget always resumes.
+    bool release = flush || allTracksQueued || interleaveMaxTimeUs_ - timeUs > interleaveWindowUs_ ||
+        interleaveBytes_.load() > queueLowWatermark_;
+    if (!release) {
+        return nullptr;
+    }
+    std::shared_ptr<BlockBuffer> buffer = earliest->front();
+    earliest->pop_front();
+    interleaveBytes_ -= buffer->info_.size;
+    interleaveSamples_--;
+    return buffer;
+}
+
+void MuxerEngineImpl::ClearInterleaver()
+{
+    interleaveQueues_.clear();
+    interleaveBytes_ = 0;
+    interleaveSamples_ = 0;
+    interleaveMaxTimeUs_ = 0;
+}
+
+int64_t MuxerEngineImpl::GetInterleaveTime(const TrackSampleInfo &info)
+{
+    // samples have to reach the file in decode order, the presentation order differs when there are B-frames.
+    return info.decodeTimeUs != SAMPLE_TIME_NONE ? info.decodeTimeUs : info.timeUs;
+}
+
+bool MuxerEngineImpl::AcquireQueueBudget(int64_t size)
+{
+    // a sample larger than the whole budget is still accepted once the queue has drained
+    int64_t queued = queuedBytes_.load();
+    if (queued > 0 && queued + size > queueHighWatermark_) {
+        AVCodecTrace trace("MuxerEngine::WaitQueueBudget");
+        std::unique_lock<std::mutex> lock(budgetMutex_);
+        queueThrottled_ = true;
+        budgetCond_.wait(lock, [this] { return budgetStopping_ || !queueThrottled_ || IsQueueDrained(); });
+        queueThrottled_ = false;
+        if (budgetStopping_) {
+            return false;
         }
     }
+    queuedBytes_ += size;
+    return true;
+}
+
+bool MuxerEngineImpl::TryAcquireQueueBudget(int64_t size)
+{
+    int64_t queued = queuedBytes_.load();
+    bool hasSpace = (queued == 0 || queued + size <= queueHighWatermark_) && que_.Size() < que_.Capacity();
+    if (!queueThrottled_.load() && hasSpace) {
+        queuedBytes_ += size;
+        return true;
+    }
+    queueThrottled_ = true;
+    // the writer thread may have drained the queue before it could see the flag, then nobody else clears it.
+    bool expected = true;
+    if (IsQueueDrained() && queueThrottled_.compare_exchange_strong(expected, false)) {
+        queuedBytes_ += size;
+        return true;
+    }
+    return false;
+}
+
+void MuxerEngineImpl::ReleaseQueueBudget(int64_t size)
+{
+    queuedBytes_ -= size;
+    if (!queueThrottled_.load() || !IsQueueDrained()) {
+        return;
+    }
+    bool expected = true;
+    if (!queueThrottled_.compare_exchange_strong(expected, false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(budgetMutex_);
+        budgetCond_.notify_all();
+    }
+    if (nonBlocking_ && callback_ != nullptr) {
+        callback_->OnSpaceAvailable();
+    }
+}
+
+bool MuxerEngineImpl::IsQueueDrained()
+{
+    return queuedBytes_.load() <= queueLowWatermark_ && que_.Size() <= que_.Capacity() / 2;
 }
 
 bool MuxerEngineImpl::CanAddTrack(std::string &mimeType)
@@ -17,13 +17,14 @@
 #define MUXER_ENGINE_IMPL_H
 
 #include <map>
+#include <deque>
 #include <atomic>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include "i_muxer_engine.h"
 #include "muxer.h"
-#include "block_queue.h"
+#include "spsc_ring_queue.h"
 
 namespace OHOS {
 namespace Media {
@@ -33,10 +34,13 @@ public:
     ~MuxerEngineImpl() override;
     int32_t SetLocation(float latitude, float longitude) override;
     int32_t SetRotation(int32_t rotation) override;
+    int32_t SetParameter(const MediaDescription &param) override;
+    int32_t SetCallback(const std::shared_ptr<AVMuxerCallback> &callback) override;
     int32_t AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc) override;
     int32_t Start() override;
     int32_t WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info) override;
     int32_t Stop() override;
+    int32_t SetNextOutputFile(int32_t fd) override;
     int32_t DumpInfo(int32_t fd) override;
     
     enum class State {
@@ -47,19 +51,35 @@ public:
     };
 
 private:
+    struct BlockBuffer {
+        std::shared_ptr<AVSharedMemory> buffer_;
+        TrackSampleInfo info_;
+    };
+
     int32_t StartThread(std::string name);
     int32_t StopThread() noexcept;
     void ThreadProcessor();
+    int32_t ParseQueueBudget(const MediaDescription &param);
+    bool AcquireQueueBudget(int64_t size);
+    bool TryAcquireQueueBudget(int64_t size);
+    void ReleaseQueueBudget(int64_t size);
+    bool IsQueueDrained();
+    void WriteToPlugin(const std::shared_ptr<BlockBuffer> &buffer);
+    int32_t ParseSegmentPolicy(const MediaDescription &param);
+    bool ShouldSwitchOutput(const TrackSampleInfo &info);
+    void SwitchOutput(const TrackSampleInfo &info);
+    void CloseNextOutputFile();
+    void PushToInterleaver(const std::shared_ptr<BlockBuffer> &buffer);
+    std::shared_ptr<BlockBuffer> PopFromInterleaver(bool flush);
+    void ClearInterleaver();
+    static int64_t GetInterleaveTime(const TrackSampleInfo &info);
+    static void MergeMediaDescription(MediaDescription &dst, const MediaDescription &src);
     void DumpMediaDescription(int32_t fd, const MediaDescription &trackDesc);
     bool CanAddTrack(std::string &mimeType);
     bool CheckKeys(std::string &mimeType, const MediaDescription &trackDesc);
     std::string ConvertStateToString(State state);
     int32_t TranslatePluginStatus(Plugin::Status error);
-
-    struct BlockBuffer {
-        std::shared_ptr<AVSharedMemory> buffer_;
-        TrackSampleInfo info_;
-    };
+    Plugin::Status ReplacePlugin(const MediaDescription &param);
 
     int32_t appUid_ = -1;
     int32_t appPid_ = -1;
@@ -67,9 +87,42 @@ private:
     OutputFormat format_;
     std::atomic<State> state_ = State::UNINITIALIZED;
     std::shared_ptr<Plugin::Muxer> muxer_ = nullptr;
+    bool hasLocation_ = false;
+    float latitude_ = 0.0f;
+    float longitude_ = 0.0f;
+    int32_t rotation_ = 0;
     std::map<int32_t, std::string> tracks_;
     std::map<int32_t, MediaDescription> mediaDescMap_;
-    BlockQueue<std::shared_ptr<BlockBuffer>> que_;
+    MediaDescription parameters_;
+    std::shared_ptr<AVMuxerCallback> callback_ = nullptr;
+    SpscRingQueue<std::shared_ptr<BlockBuffer>> que_;
+    int64_t queueHighWatermark_ = 0;
+    int64_t queueLowWatermark_ = 0;
+    int32_t queueMaxSamples_ = 0;
+    std::atomic<int64_t> queuedBytes_ = 0;
+    std::atomic<bool> queueThrottled_ = false;
+    bool nonBlocking_ = false;
+    std::mutex writeMutex_;
+    int64_t interleaveWindowUs_ = 0;
+    int64_t interleaveMaxTimeUs_ = 0;
+    std::map<uint32_t, std::deque<std::shared_ptr<BlockBuffer>>> interleaveQueues_;
+    std::atomic<int64_t> interleaveBytes_ = 0;
+    std::atomic<uint32_t> interleaveSamples_ = 0;
+    std::atomic<int64_t> muxSamples_ = 0;
+    std::atomic<int64_t> muxTimeUs_ = 0;
+    std::atomic<int64_t> muxMaxTimeUs_ = 0;
+    std::atomic<int32_t> nextOutputFd_ = -1;
+    int64_t segmentMaxDurationUs_ = 0;
+    int64_t segmentMaxBytes_ = 0;
+    int64_t segmentStartUs_ = -1;
+    int64_t segmentBytes_ = 0;
+    bool segmentLimitWarned_ = false;
+    int32_t segmentTrackIndex_ = -1;
+    std::atomic<int32_t> segmentCount_ = 1;
+    std::atomic<bool> outputFailed_ = false;
+    std::mutex budgetMutex_;
+    std::condition_variable budgetCond_;
+    bool budgetStopping_ = false;
     std::string threadName_;
     std::mutex mutex_;
     std::condition_variable cond_;
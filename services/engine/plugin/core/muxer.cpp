@@ -31,6 +31,15 @@ Status Muxer::SetRotation(int32_t rotation)
     return muxer_->SetRotation(rotation);
 }
 
+Status Muxer::SetParameter(const MediaDescription &param)
+{
+    // the plugins built against api version 1.0 have no SetParameter in their vtable.
+    if (apiVersion_ < MAKE_VERSION(1, 1)) {
+        return Status::NO_ERROR;
+    }
+    return muxer_->SetParameter(param);
+}
+
 Status Muxer::AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc)
 {
     return muxer_->AddTrack(trackIndex, trackDesc);
@@ -50,6 +59,27 @@ Status Muxer::Stop()
 {
     return muxer_->Stop();
 }
+
+Status Muxer::GetStatistics(MediaDescription &stats)
+{
+    if (apiVersion_ < MAKE_VERSION(1, 2)) {
+        return Status::NO_ERROR;
+    }
+    return muxer_->GetStatistics(stats);
+}
+
+Status Muxer::SwitchOutput(int32_t fd)
+{
+    if (apiVersion_ < MAKE_VERSION(1, 3)) {
+        return Status::ERROR_UNIMPLEMENTED;
+    }
+    return muxer_->SwitchOutput(fd);
+}
+
+std::string Muxer::GetName() const
+{
+    return muxer_->GetName();
+}
 } // namespace Plugin
 } // namespace Media
 } // namespace OHOS
\ No newline at end of file
@@ -29,10 +29,14 @@ public:
 
     Status SetLocation(float latitude, float longitude);
     Status SetRotation(int32_t rotation);
+    Status SetParameter(const MediaDescription &param);
     Status AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc);
     Status Start();
     Status WriteSampleBuffer(uint8_t *sampleBuffer, const TrackSampleInfo &info);
     Status Stop();
+    Status GetStatistics(MediaDescription &stats);
+    Status SwitchOutput(int32_t fd);
+    std::string GetName() const;
 
 private:
     friend class MuxerFactory;
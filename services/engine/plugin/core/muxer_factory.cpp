@@ -16,12 +16,29 @@
 #include "muxer_factory.h"
 #include <utility>
 #include <algorithm>
+#include <fstream>
+#include <sstream>
 #include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "muxer_plugin.h"
+#include "av_common.h"
 #include "avcodec_log.h"
 
+#ifndef AV_CODEC_PLUGIN_IDLE_UNLOAD_SEC
+#define AV_CODEC_PLUGIN_IDLE_UNLOAD_SEC 300
+#endif
+
+#ifndef AV_CODEC_MUXER_PLUGIN_MANIFEST
+#define AV_CODEC_MUXER_PLUGIN_MANIFEST "/system/etc/av_codec/muxer_plugins.cfg"
+#endif
+
 namespace {
     constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "MuxerFactory"};
+    const std::map<std::string, uint32_t> MANIFEST_OUTPUT_FORMATS = {
+        {"mp4", OHOS::Media::OUTPUT_FORMAT_MPEG_4},
+        {"m4a", OHOS::Media::OUTPUT_FORMAT_M4A},
+    };
 }
 
 namespace OHOS {
@@ -32,46 +49,299 @@ static std::string g_fileSeparator = "/";
 static std::string g_fileMark = "Muxer";
 static std::string g_libFileTail = AV_CODEC_PLUGIN_FILE_TAIL;
 
-MuxerFactory::MuxerFactory()
+MuxerFactory::MuxerFactory() : idleUnloadTime_(AV_CODEC_PLUGIN_IDLE_UNLOAD_SEC)
 {
     RegisterPlugins();
 }
 
 MuxerFactory::~MuxerFactory()
 {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idleThreadExit_ = true;
+    }
+    idleCond_.notify_all();
+    if (idleThread_ != nullptr && idleThread_->joinable()) {
+        idleThread_->join();
+    }
+    idleThread_ = nullptr;
     UnregisterAllPlugins();
 }
 
-std::shared_ptr<Muxer> MuxerFactory::CreatePlugin(int32_t fd, uint32_t outputFormat)
+std::shared_ptr<Muxer> MuxerFactory::CreatePlugin(int32_t fd, uint32_t outputFormat, const std::string& skipPlugin)
 {
     AVCODEC_LOGD("CreatePlugin:  fd %{public}d, outputFormat %{public}d", fd, outputFormat);
-    std::string pluginName;
-    int32_t maxProb = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    LoadPluginsForFormat(outputFormat);
+    for (auto& pluginName : GetRankedPlugins(outputFormat)) {
+        AVCODEC_LOGD("pluginName %{public}s", pluginName.c_str());
+        if (pluginName == skipPlugin) {
+            continue;
+        }
+        std::shared_ptr<PluginRegInfo> regInfo = registerData_->registerTable[pluginName];
+        auto plugin = regInfo->pluginDef->creator(pluginName, fd);
+        if (plugin == nullptr) {
+            AVCODEC_LOGW("Create plugin %{public}s failed, try the next one", pluginName.c_str());
+            continue;
+        }
+        std::shared_ptr<PluginLoader> loader = regInfo->loader;
+        if (loader == nullptr) {
+            return std::shared_ptr<Muxer>(
+                    new Muxer(regInfo->packageDef->pkgVersion, regInfo->pluginDef->apiVersion, plugin));
+        }
+        // the library stays loaded while any of its instances lives, the instance goes before it is released.
+        loader->AddInstance();
+        return std::shared_ptr<Muxer>(
+                new Muxer(regInfo->packageDef->pkgVersion, regInfo->pluginDef->apiVersion, plugin),
+                [this, loader](Muxer* muxer) {
+                    delete muxer;
+                    ReleaseInstance(loader);
+                });
+    }
+    AVCODEC_LOGE("No plugins matching output format - %{public}d", outputFormat);
+    return nullptr;
+}
+
+const std::vector<std::string>& MuxerFactory::GetRankedPlugins(uint32_t outputFormat)
+{
+    auto it = registerData_->formatIndex.find(outputFormat);
+    if (it != registerData_->formatIndex.end()) {
+        return it->second;
+    }
+    // the plugins are sniffed once per format, the higher probability wins, then the higher rank.
+    std::vector<std::pair<int32_t, std::string>> candidates;
     for (auto& name : registerData_->registerNames) {
         std::shared_ptr<PluginRegInfo> regInfo = registerData_->registerTable[name];
         if (regInfo->pluginDef->pluginType == PluginType::MUXER) {
             auto prob = regInfo->pluginDef->sniffer(name, outputFormat);
-            if (prob > maxProb) {
-                maxProb = prob;
-                pluginName = name;
+            if (prob > 0) {
+                candidates.emplace_back(prob, name);
             }
         }
     }
-    AVCODEC_LOGD("maxProb %{public}d, pluginName %{public}s", maxProb, pluginName.c_str());
-    if (!pluginName.empty()) {
-        std::shared_ptr<PluginRegInfo> regInfo = registerData_->registerTable[pluginName];
-        auto plugin = regInfo->pluginDef->creator(pluginName, fd);
-        return std::shared_ptr<Muxer>(
-                new Muxer(regInfo->packageDef->pkgVersion, regInfo->pluginDef->apiVersion, plugin));
+    std::stable_sort(candidates.begin(), candidates.end(), [this](const auto& left, const auto& right) {
+        if (left.first != right.first) {
+            return left.first > right.first;
+        }
+        return registerData_->registerTable[left.second]->pluginDef->rank >
+            registerData_->registerTable[right.second]->pluginDef->rank;
+    });
+    std::vector<std::string>& ranked = registerData_->formatIndex[outputFormat];
+    for (auto& candidate : candidates) {
+        ranked.push_back(candidate.second);
+    }
+    AVCODEC_LOGI("Output format %{public}u has %{public}zu plugins, best %{public}s", outputFormat, ranked.size(),
+        ranked.empty() ? "none" : ranked.front().c_str());
+    return ranked;
+}
+
+void MuxerFactory::ReleaseInstance(const std::shared_ptr<PluginLoader>& loader)
+{
+    // under the lock of the unload thread, so it sees the count and the idle time change together.
+    std::lock_guard<std::mutex> lock(mutex_);
+    loader->RemoveInstance();
+    if (loader->GetInstanceCount() == 0) {
+        idleCond_.notify_all();
+    }
+}
+
+void MuxerFactory::IdleUnloadProcessor()
+{
+    pthread_setname_np(pthread_self(), "muxer_plugin_gc");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!idleThreadExit_) {
+        // wake up when the earliest idle package is due, or check again a whole period later.
+        auto now = std::chrono::steady_clock::now();
+        auto deadline = now + idleUnloadTime_;
+        std::vector<std::shared_ptr<PluginLoader>> expired;
+        for (auto& loader : registeredLoaders_) {
+            if (loader->GetInstanceCount() != 0) {
+                continue;
+            }
+            auto due = loader->GetIdleSince() + idleUnloadTime_;
+            if (due <= now) {
+                expired.push_back(loader);
+            } else {
+                deadline = std::min(deadline, due);
+            }
+        }
+        for (auto& loader : expired) {
+            UnloadPackage(loader);
+        }
+        if (registeredLoaders_.empty()) {
+            idleCond_.wait(lock, [this] { return idleThreadExit_ || !registeredLoaders_.empty(); });
+        } else {
+            idleCond_.wait_until(lock, deadline);
+        }
+    }
+}
+
+void MuxerFactory::UnloadPackage(const std::shared_ptr<PluginLoader>& loader)
+{
+    std::shared_ptr<PluginLoader> holder = loader;
+    AVCODEC_LOGI("Unload idle plugin package %{public}s", holder->GetName().c_str());
+    holder->FetchUnregisterFunction()();
+    auto& names = registerData_->registerNames;
+    names.erase(std::remove_if(names.begin(), names.end(), [this, &holder](const std::string& name) {
+        auto it = registerData_->registerTable.find(name);
+        if (it == registerData_->registerTable.end() || it->second->loader != holder) {
+            return false;
+        }
+        registerData_->registerTable.erase(it);
+        return true;
+    }), names.end());
+    registerData_->formatIndex.clear();
+    registeredLoaders_.erase(std::remove(registeredLoaders_.begin(), registeredLoaders_.end(), holder),
+        registeredLoaders_.end());
+    loadedPackages_.erase(holder->GetName());
+    bool listed = std::any_of(manifest_.begin(), manifest_.end(), [&holder](const ManifestEntry& entry) {
+        return entry.packageName == holder->GetName();
+    });
+    if (!listed) {
+        // a package found by the scan comes back with the next scan.
+        scanned_ = false;
+    }
+    // the registrations are gone, the library is closed with the last reference.
+}
+
+int32_t MuxerFactory::DumpInfo(int32_t fd)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string dumpString;
+    dumpString += "Current MuxerFactory plugin idle unload time is: " + std::to_string(idleUnloadTime_.count()) +
+        " s\n";
+    auto now = std::chrono::steady_clock::now();
+    for (auto& loader : registeredLoaders_) {
+        dumpString += "    package " + loader->GetName() + ": loaded, " +
+            std::to_string(loader->GetInstanceCount()) + " instances";
+        if (loader->GetInstanceCount() == 0) {
+            dumpString += ", idle " + std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+                now - loader->GetIdleSince()).count()) + " s";
+        }
+        dumpString += "\n";
+    }
+    for (auto& package : GetStaticPackages()) {
+        dumpString += "    package " + package.name + ": static\n";
+    }
+    for (auto& entry : manifest_) {
+        if (loadedPackages_.count(entry.packageName) == 0) {
+            dumpString += "    package " + entry.packageName + ": not loaded\n";
+        }
+    }
+    dumpString += "Current MuxerFactory registered plugins: " +
+        std::to_string(registerData_->registerNames.size()) + ", indexed output formats: " +
+        std::to_string(registerData_->formatIndex.size()) + "\n";
+    if (fd < 0) {
+        AVCODEC_LOGI("%{public}s", dumpString.c_str());
     } else {
-        AVCODEC_LOGE("No plugins matching output format - %{public}d", outputFormat);
+        write(fd, dumpString.c_str(), dumpString.size());
     }
-    return nullptr;
+    return 0;
 }
 
 void MuxerFactory::RegisterPlugins()
 {
-    RegisterDynamicPlugins(AV_CODEC_PLUGIN_PATH);
+    RegisterStaticPlugins();
+    // with a manifest the libraries are opened by the first CreatePlugin that needs them.
+    if (!LoadManifest(AV_CODEC_MUXER_PLUGIN_MANIFEST)) {
+        AVCODEC_LOGI("No plugin manifest, load all plugins in %{public}s", AV_CODEC_PLUGIN_PATH);
+        RegisterDynamicPlugins(AV_CODEC_PLUGIN_PATH);
+        scanned_ = true;
+    }
+}
+
+void MuxerFactory::RegisterStaticPlugins()
+{
+    // the packages linked into the service take the place of their libraries in the manifest and the scan.
+    for (auto& package : GetStaticPackages()) {
+        if (loadedPackages_.count(package.name) != 0) {
+            continue;
+        }
+        loadedPackages_.insert(package.name);
+        package.registerFunc(std::make_shared<RegisterImpl>(registerData_));
+        staticUnregisterFuncs_.push_back(package.unregisterFunc);
+        AVCODEC_LOGI("Register static plugin package %{public}s", package.name.c_str());
+    }
+}
+
+bool MuxerFactory::LoadManifest(const char* manifestPath)
+{
+    std::ifstream file(manifestPath);
+    if (!file.is_open()) {
+        return false;
+    }
+    // each line is "<package name> <output formats separated by ','> <library file in AV_CODEC_PLUGIN_PATH>"
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        ManifestEntry entry;
+        std::string formats;
+        std::string libName;
+        if (!(fields >> entry.packageName >> formats >> libName)) {
+            AVCODEC_LOGW("Invalid plugin manifest line: %{public}s", line.c_str());
+            continue;
+        }
+        std::istringstream formatNames(formats);
+        std::string formatName;
+        while (std::getline(formatNames, formatName, ',')) {
+            auto it = MANIFEST_OUTPUT_FORMATS.find(formatName);
+            if (it != MANIFEST_OUTPUT_FORMATS.end()) {
+                entry.outputFormats.insert(it->second);
+            } else {
+                AVCODEC_LOGW("Unknown output format %{public}s of %{public}s", formatName.c_str(),
+                    entry.packageName.c_str());
+            }
+        }
+        entry.libPath = std::string(AV_CODEC_PLUGIN_PATH) + g_fileSeparator + libName;
+        manifest_.push_back(entry);
+    }
+    AVCODEC_LOGI("Plugin manifest lists %{public}zu packages", manifest_.size());
+    return !manifest_.empty();
+}
+
+void MuxerFactory::LoadPluginsForFormat(uint32_t outputFormat)
+{
+    bool listed = false;
+    for (auto& entry : manifest_) {
+        if (entry.outputFormats.count(outputFormat) == 0) {
+            continue;
+        }
+        listed = true;
+        if (loadedPackages_.count(entry.packageName) == 0) {
+            LoadPlugin(entry.packageName, entry.libPath);
+        }
+    }
+    if (!listed && !scanned_) {
+        // the manifest may be out of date, look for the format in the plugins it does not list.
+        if (!manifest_.empty()) {
+            AVCODEC_LOGW("Output format %{public}u is not in the plugin manifest, scan %{public}s", outputFormat,
+                AV_CODEC_PLUGIN_PATH);
+        }
+        RegisterDynamicPlugins(AV_CODEC_PLUGIN_PATH);
+        scanned_ = true;
+    }
+}
+
+void MuxerFactory::LoadPlugin(const std::string& packageName, const std::string& libPath)
+{
+    // a package is opened once even if it fails, a broken library is not retried for every muxer.
+    loadedPackages_.insert(packageName);
+    std::shared_ptr<PluginLoader> loader = PluginLoader::Create(packageName, libPath);
+    if (loader) {
+        loader->FetchRegisterFunction()(std::make_shared<RegisterImpl>(registerData_, loader));
+        registeredLoaders_.push_back(loader);
+        AVCODEC_LOGI("Load plugin package %{public}s", packageName.c_str());
+        if (idleUnloadTime_.count() > 0 && idleThread_ == nullptr) {
+            idleThread_ = std::make_unique<std::thread>(&MuxerFactory::IdleUnloadProcessor, this);
+        }
+        idleCond_.notify_all();
+    } else {
+        AVCODEC_LOGE("Load plugin package %{public}s from %{public}s failed", packageName.c_str(),
+            libPath.c_str());
+    }
 }
 
 void MuxerFactory::RegisterDynamicPlugins(const char* libDirPath)
@@ -79,7 +349,6 @@ void MuxerFactory::RegisterDynamicPlugins(const char* libDirPath)
     DIR* libDir = opendir(libDirPath);
     if (libDir) {
         struct dirent* lib = nullptr;
-        std::shared_ptr<PluginLoader> loader = nullptr;
         while ((lib = readdir(libDir))) {
             if (lib->d_name[0] == '.') {
                 continue;
@@ -93,12 +362,10 @@ void MuxerFactory::RegisterDynamicPlugins(const char* libDirPath)
             }
             std::string pluginName =
                 libName.substr(g_libFileHead.size(), libName.size() - g_libFileHead.size() - g_libFileTail.size());
-            std::string libPath = libDirPath + g_fileSeparator + lib->d_name;
-            loader = PluginLoader::Create(pluginName, libPath);
-            if (loader) {
-                loader->FetchRegisterFunction()(std::make_shared<RegisterImpl>(registerData_, loader));
-                registeredLoaders_.push_back(loader);
+            if (loadedPackages_.count(pluginName) != 0) {
+                continue;
             }
+            LoadPlugin(pluginName, libDirPath + g_fileSeparator + lib->d_name);
         }
         closedir(libDir);
     }
@@ -111,8 +378,14 @@ void MuxerFactory::UnregisterAllPlugins()
         loader.reset();
     }
     registeredLoaders_.clear();
+    for (auto& unregisterFunc : staticUnregisterFuncs_) {
+        unregisterFunc();
+    }
+    staticUnregisterFuncs_.clear();
+    loadedPackages_.clear();
     registerData_->registerNames.clear();
     registerData_->registerTable.clear();
+    registerData_->formatIndex.clear();
 }
 
 bool MuxerFactory::RegisterData::IsExist(const std::string& name)
@@ -137,6 +410,7 @@ Status MuxerFactory::RegisterImpl::AddPlugin(const PluginDefBase& def)
     
     registerData->registerTable[pluginDef.name] = regInfo;
     registerData->registerNames.push_back(pluginDef.name);
+    registerData->formatIndex.clear();
     return Status::NO_ERROR;
 }
 
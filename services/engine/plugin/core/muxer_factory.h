@@ -17,6 +17,11 @@
 #define MUXER_FACTORY_H
 
 #include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
 #include <vector>
 #include "muxer.h"
 #include "plugin_loader.h"
@@ -35,16 +40,31 @@ public:
         return impl;
     }
 
-    std::shared_ptr<Muxer> CreatePlugin(int32_t fd, uint32_t outputFormat);
-    
+    // skipPlugin names a plugin not to be created, such as one that did not take the muxer parameters.
+    std::shared_ptr<Muxer> CreatePlugin(int32_t fd, uint32_t outputFormat, const std::string& skipPlugin = "");
+    int32_t DumpInfo(int32_t fd);
+
 private:
     MuxerFactory();
 
     void RegisterPlugins();
+    void RegisterStaticPlugins();
     void RegisterDynamicPlugins(const char* libDirPath);
+    bool LoadManifest(const char* manifestPath);
+    void LoadPluginsForFormat(uint32_t outputFormat);
+    void LoadPlugin(const std::string& packageName, const std::string& libPath);
     void UnregisterAllPlugins();
+    const std::vector<std::string>& GetRankedPlugins(uint32_t outputFormat);
+    void ReleaseInstance(const std::shared_ptr<PluginLoader>& loader);
+    void IdleUnloadProcessor();
+    void UnloadPackage(const std::shared_ptr<PluginLoader>& loader);
 
 private:
+    struct ManifestEntry {
+        std::string packageName;
+        std::set<uint32_t> outputFormats;
+        std::string libPath;
+    };
     struct PluginRegInfo {
         std::shared_ptr<PackageDef> packageDef;
         std::shared_ptr<MuxerPluginDef> pluginDef;
@@ -53,6 +73,8 @@ private:
     struct RegisterData {
         std::vector<std::string> registerNames;
         std::map<std::string, std::shared_ptr<PluginRegInfo>> registerTable;
+        // output format -> the plugins sniffing it, best first; rebuilt lazily after the registrations change.
+        std::unordered_map<uint32_t, std::vector<std::string>> formatIndex;
         bool IsExist(const std::string& name);
     };
     struct RegisterImpl : PackageRegister {
@@ -74,6 +96,15 @@ private:
 
     std::shared_ptr<RegisterData> registerData_ = std::make_shared<RegisterData>();
     std::vector<std::shared_ptr<PluginLoader>> registeredLoaders_;
+    std::vector<UnregisterFunc> staticUnregisterFuncs_;
+    std::vector<ManifestEntry> manifest_;
+    std::set<std::string> loadedPackages_;
+    bool scanned_ = false;
+    std::chrono::seconds idleUnloadTime_;
+    std::unique_ptr<std::thread> idleThread_ = nullptr;
+    bool idleThreadExit_ = false;
+    std::condition_variable idleCond_;
+    std::mutex mutex_;
 };
 } // namespace Plugin
 } // namespace Media
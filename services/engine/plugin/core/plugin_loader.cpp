@@ -51,6 +51,33 @@ UnregisterFunc PluginLoader::FetchUnregisterFunction()
     return unregisterFunc_;
 }
 
+const std::string& PluginLoader::GetName() const
+{
+    return name_;
+}
+
+void PluginLoader::AddInstance()
+{
+    instances_++;
+}
+
+void PluginLoader::RemoveInstance()
+{
+    // the time goes first, a count of 0 is never seen together with the time of an earlier idle period.
+    idleSince_ = std::chrono::steady_clock::now();
+    instances_--;
+}
+
+int32_t PluginLoader::GetInstanceCount() const
+{
+    return instances_;
+}
+
+std::chrono::steady_clock::time_point PluginLoader::GetIdleSince() const
+{
+    return idleSince_;
+}
+
 void* PluginLoader::LoadPluginFile(const std::string& path)
 {
     auto pathStr = path.c_str();
@@ -16,6 +16,8 @@
 #ifndef PLUGIN_CORE_PLUGIN_LOADER_H
 #define PLUGIN_CORE_PLUGIN_LOADER_H
 
+#include <atomic>
+#include <chrono>
 #include "plugin_base.h"
 #include "plugin_definition.h"
 
@@ -38,6 +40,16 @@ public:
 
     UnregisterFunc FetchUnregisterFunction();
 
+    const std::string &GetName() const;
+
+    void AddInstance();
+
+    void RemoveInstance();
+
+    int32_t GetInstanceCount() const;
+
+    std::chrono::steady_clock::time_point GetIdleSince() const;
+
 private:
     static void* LoadPluginFile(const std::string &path);
 
@@ -50,6 +62,8 @@ private:
     const std::string name_;
     RegisterFunc registerFunc_ {nullptr};
     UnregisterFunc unregisterFunc_ {nullptr};
+    std::atomic<int32_t> instances_ {0};
+    std::atomic<std::chrono::steady_clock::time_point> idleSince_ {std::chrono::steady_clock::now()};
 };
 } // namespace Plugin
 } // namespace Media
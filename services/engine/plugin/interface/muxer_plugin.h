@@ -28,17 +28,44 @@ struct MuxerPlugin : public PluginBase {
     explicit MuxerPlugin(std::string &&name) : PluginBase(std::move(name)) {}
     virtual Status SetLocation(float latitude, float longitude) = 0;
     virtual Status SetRotation(int32_t rotation) = 0;
+    /**
+     * @brief Set the muxer options, it is called before AddTrack. Since api version 1.1.
+     * The keys unknown to the plugin should be ignored.
+     */
+    virtual Status SetParameter(const MediaDescription &param)
+    {
+        (void)param;
+        return Status::NO_ERROR;
+    }
     virtual Status AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc) = 0;
     virtual Status Start() = 0;
     virtual Status WriteSampleBuffer(uint8_t *sampleBuffer, const TrackSampleInfo &info) = 0;
     virtual Status Stop() = 0;
+    /**
+     * @brief Get the statistics of the plugin for dumping, it may be called from any thread. Since api version 1.2.
+     */
+    virtual Status GetStatistics(MediaDescription &stats)
+    {
+        (void)stats;
+        return Status::NO_ERROR;
+    }
+    /**
+     * @brief Finish the current output file and go on with the same tracks in the new one, the timestamps of
+     * the new file start from the next sample written. The plugin keeps its own duplicate of the fd.
+     * Since api version 1.3.
+     */
+    virtual Status SwitchOutput(int32_t fd)
+    {
+        (void)fd;
+        return Status::ERROR_UNIMPLEMENTED;
+    }
 };
 
 /// Muxer plugin api major number.
 #define MUXER_API_VERSION_MAJOR (1)
 
 /// Muxer plugin api minor number
-#define MUXER_API_VERSION_MINOR (0)
+#define MUXER_API_VERSION_MINOR (3)
 
 /// Muxer plugin version
 #define MUXER_API_VERSION MAKE_VERSION(MUXER_API_VERSION_MAJOR, MUXER_API_VERSION_MINOR)
@@ -18,6 +18,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include <cstdint> // NOLINT: using int32_t in this file
 
 
@@ -208,6 +209,36 @@ using UnregisterFunc = void (*)();
 #endif
 #endif
 
+/// Package registration function defined by PLUGIN_DEFINITION.
+using PackageRegisterFunc = Status (*)(const std::shared_ptr<PackageRegister>& pkgReg);
+
+/**
+ * @brief A plugin package linked into the service, it is registered without loading a library.
+ *
+ * @since 10
+ * @version 1.0
+ */
+struct StaticPackageDef {
+    std::string name;                           ///< Package name, same as the one of the dynamic library.
+    PackageRegisterFunc registerFunc {nullptr}; ///< Package registration function.
+    UnregisterFunc unregisterFunc {nullptr};    ///< Package deregister function.
+};
+
+/// The packages linked into the service, filled by PLUGIN_DEFINITION when AV_CODEC_STATIC_PLUGIN is defined.
+inline std::vector<StaticPackageDef>& GetStaticPackages()
+{
+    static std::vector<StaticPackageDef> packages;
+    return packages;
+}
+
+/// Adds a package to the static packages during static initialization.
+struct StaticPackageRegistrar {
+    StaticPackageRegistrar(const char* name, PackageRegisterFunc registerFunc, UnregisterFunc unregisterFunc)
+    {
+        GetStaticPackages().push_back({ name, registerFunc, unregisterFunc });
+    }
+};
+
 /// Macro definition, string concatenation
 #define PLUGIN_PASTE_ARGS(str1, str2) str1##str2
 
@@ -220,6 +251,15 @@ using UnregisterFunc = void (*)();
 /// Macro definition, stringify
 #define PLUGIN_STRINGIFY(str) PLUGIN_STRINGIFY_ARG(str)
 
+#ifdef AV_CODEC_STATIC_PLUGIN
+/// Macro definition, adds the package to the static packages, used by PLUGIN_DEFINITION.
+#define PLUGIN_STATIC_REGISTRAR(name)                                                                                  \
+    static OHOS::Media::Plugin::StaticPackageRegistrar PLUGIN_PASTE(g_staticRegistrar_, name)(                         \
+        PLUGIN_STRINGIFY(name), PLUGIN_PASTE(register_, name), PLUGIN_PASTE(unregister_, name));
+#else
+#define PLUGIN_STATIC_REGISTRAR(name)
+#endif
+
 /**
  * @brief Macro definition, Defines basic plugin information.
  * Which is invoked during plugin package registration. All plugin packages must be implemented.
@@ -240,7 +280,8 @@ using UnregisterFunc = void (*)();
     PLUGIN_EXPORT void PLUGIN_PASTE(unregister_, name)()                                                               \
     {                                                                                                                  \
         unregisterFunc();                                                                                              \
-    }
+    }                                                                                                                  \
+    PLUGIN_STATIC_REGISTRAR(name)
 } // namespace Plugin
 } // namespace Media
 } // namespace OHOS
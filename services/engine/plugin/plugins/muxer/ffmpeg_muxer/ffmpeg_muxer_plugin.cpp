@@ -14,8 +14,11 @@
  */
 
 #include "ffmpeg_muxer_plugin.h"
+#include <algorithm>
 #include <functional>
+#include <cerrno>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include "securec.h"
@@ -25,6 +28,36 @@
 
 namespace {
     constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "FfmpegMuxerPlugin"};
+    // the upper bound of the bytes taken by each sample in the sample tables, as if every sample
+    // had its own stts, ctts and stsc entry.
+    constexpr int64_t MOOV_VIDEO_SAMPLE_SIZE = 4 + 8 + 8 + 4 + 12; // stsz, stts, ctts, stss, stsc
+    constexpr int64_t MOOV_AUDIO_SAMPLE_SIZE = 4 + 8 + 12; // stsz, stts, stsc
+    constexpr int64_t MOOV_CHUNK_OFFSET_SIZE = 4;
+    constexpr int64_t MOOV_LARGE_CHUNK_OFFSET_SIZE = 8;
+    constexpr int64_t MOOV_TRACK_OVERHEAD = 4 * 1024;
+    constexpr int64_t MOOV_MOVIE_OVERHEAD = 4 * 1024;
+    constexpr int64_t MOOV_MARGIN_DIVISOR = 4; // reserve another 25% for the estimation
+    constexpr double DEFAULT_FRAME_RATE = 30.0;
+    constexpr int64_t AUDIO_FRAME_SAMPLES = 1024;
+    constexpr int64_t OTHER_SAMPLE_RATE = 50;
+    constexpr int64_t USEC_PER_SEC = 1000000;
+    constexpr uint32_t BOX_HEADER_SIZE = 8;
+    constexpr uint32_t BYTE_BITS = 8;
+    constexpr int32_t DEFAULT_IO_BUFFER_SIZE = 512 * 1024;
+    constexpr int32_t MAX_IO_BUFFER_SIZE = 16 * 1024 * 1024;
+    constexpr int32_t DEFAULT_DIRECT_WRITE_THRESHOLD = 128 * 1024;
+    constexpr int32_t MAX_PENDING_WRITE_SIZE = 64 * 1024;
+    constexpr int32_t MAX_WRITE_IOV_COUNT = 2;
+    constexpr uint32_t ASYNC_IO_DEPTH = 8; // writes in flight, each of them holds an io buffer
+    constexpr int32_t DIRECT_IO_WRITE_BEHIND_BUFFERS = 3; // one being filled, one being written, one spare
+    constexpr int32_t MAX_WRITE_BEHIND_BUFFERS = 8;
+    constexpr int32_t DIRECT_IO_ALIGNMENT = 4096;
+    constexpr int64_t DEFAULT_WRITEBACK_INTERVAL = 8 * 1024 * 1024;
+    constexpr int64_t MIN_WRITEBACK_INTERVAL = 1024 * 1024;
+    constexpr int64_t PREALLOCATE_CHUNKS = 8; // the expected size is allocated in this many steps
+    constexpr int64_t MIN_PREALLOCATE_CHUNK = 4 * 1024 * 1024;
+    constexpr int64_t MAX_PREALLOCATE_CHUNK = 64 * 1024 * 1024;
+    constexpr int64_t DEFAULT_PREALLOCATE_CHUNK = 16 * 1024 * 1024;
 }
 
 namespace {
@@ -51,9 +84,12 @@ int32_t Sniff(const std::string& pluginName, uint32_t outputFormat)
     if (pluginName.empty()) {
         return 0;
     }
-    auto plugin = g_pluginOutputFmt[pluginName];
+    auto plugin = g_pluginOutputFmt.find(pluginName);
+    if (plugin == g_pluginOutputFmt.end()) {
+        return 0;
+    }
     int32_t confidence = 0;
-    auto it = g_supportedMuxer.find(plugin->name);
+    auto it = g_supportedMuxer.find(plugin->second->name);
     if (it != g_supportedMuxer.end() && it->second == outputFormat) {
         confidence = ffmpegConfidence;
     }
@@ -63,17 +99,12 @@ int32_t Sniff(const std::string& pluginName, uint32_t outputFormat)
 
 Status RegisterMuxerPlugins(const std::shared_ptr<Register>& reg)
 {
-    const AVOutputFormat *outputFormat = nullptr;
-    void *ite = nullptr;
-    while ((outputFormat = av_muxer_iterate(&ite))) {
-        if (!IsMuxerSupported(outputFormat->name)) {
+    // only the supported muxers are looked up, instead of walking every muxer built into libavformat.
+    for (auto &supported : g_supportedMuxer) {
+        const AVOutputFormat *outputFormat = av_guess_format(supported.first.c_str(), nullptr, nullptr);
+        if (outputFormat == nullptr || !IsMuxerSupported(outputFormat->name)) {
             continue;
         }
-        if (outputFormat->long_name != nullptr) {
-            if (!strncmp(outputFormat->long_name, "raw ", 4)) { // 4
-                continue;
-            }
-        }
         std::string pluginName = "ffmpegMux_" + std::string(outputFormat->name);
         ReplaceDelimiter(".,|-<> ", '_', pluginName);
         MuxerPluginDef def;
@@ -131,13 +162,21 @@ FFmpegMuxerPlugin::FFmpegMuxerPlugin(std::string name, int32_t fd) : MuxerPlugin
     auto pkt = av_packet_alloc();
     cachePacket_ = std::shared_ptr<AVPacket> (pkt, [] (AVPacket *packet) {av_packet_free(&packet);});
     outputFormat_ = g_pluginOutputFmt[pluginName_];
+    directWriteThreshold_ = DEFAULT_DIRECT_WRITE_THRESHOLD;
+    writebackInterval_ = DEFAULT_WRITEBACK_INTERVAL;
+    formatContext_ = CreateFormatContext(AlignIoBufferSize(fd_, DEFAULT_IO_BUFFER_SIZE));
+}
+
+std::shared_ptr<AVFormatContext> FFmpegMuxerPlugin::CreateFormatContext(int32_t bufferSize)
+{
     auto fmt = avformat_alloc_context();
-    fmt->pb = InitAvIoCtx(fd_, 1);
+    CHECK_AND_RETURN_RET_LOG(fmt != nullptr, nullptr, "avformat_alloc_context failed!");
+    fmt->pb = InitAvIoCtx(fd_, 1, bufferSize, std::make_shared<int64_t>(0));
     fmt->oformat = outputFormat_.get();
     fmt->flags = static_cast<uint32_t>(fmt->flags) | static_cast<uint32_t>(AVFMT_FLAG_CUSTOM_IO);
     fmt->io_open = IoOpen;
     fmt->io_close = IoClose;
-    formatContext_ = std::shared_ptr<AVFormatContext>(fmt, [](AVFormatContext *ptr) {
+    return std::shared_ptr<AVFormatContext>(fmt, [](AVFormatContext *ptr) {
         if (ptr) {
             DeInitAvIoCtx(ptr->pb);
             avformat_free_context(ptr);
@@ -145,12 +184,58 @@ FFmpegMuxerPlugin::FFmpegMuxerPlugin(std::string name, int32_t fd) : MuxerPlugin
     });
 }
 
+Status FFmpegMuxerPlugin::SwitchOutput(int32_t fd)
+{
+    CHECK_AND_RETURN_RET_LOG(fd >= 0, Status::ERROR_INVALID_PARAMETER, "fd %{public}d is invalid!", fd);
+    int32_t newFd = dup(fd);
+    CHECK_AND_RETURN_RET_LOG(newFd >= 0, Status::ERROR_UNKNOWN, "dup fd failed, errno %{public}d", errno);
+    // the current file is finished as by Stop(), its io helpers are bound to its fd and go with its context.
+    Status ret = Stop();
+    fd_ = newFd;
+    CHECK_AND_RETURN_RET_LOG(ret == Status::NO_ERROR, ret, "finish the current file failed!");
+    std::shared_ptr<AVFormatContext> oldContext = formatContext_;
+    std::shared_ptr<AVFormatContext> newContext = CreateFormatContext(oldContext->pb->buffer_size);
+    CHECK_AND_RETURN_RET_LOG(newContext != nullptr && newContext->pb != nullptr, Status::ERROR_NO_MEMORY,
+        "create the format context failed!");
+    ret = CopyStreams(newContext.get(), oldContext.get());
+    CHECK_AND_RETURN_RET_LOG(ret == Status::NO_ERROR, ret, "copy the tracks failed!");
+    std::atomic_store(&writeBehind_, std::shared_ptr<MuxerWriteBehind>(nullptr));
+    std::atomic_store(&writeback_, std::shared_ptr<MuxerWriteback>(nullptr));
+    formatContext_ = newContext;
+    oldContext.reset();
+    SetAsyncIo(asyncIo_);
+    rebaseTime_ = true;
+    AVCODEC_LOGI("switch the output");
+    return Start();
+}
+
+Status FFmpegMuxerPlugin::CopyStreams(AVFormatContext *dst, const AVFormatContext *src)
+{
+    dst->flags = src->flags;
+    (void)av_dict_copy(&dst->metadata, src->metadata, 0);
+    for (uint32_t i = 0; i < src->nb_streams; i++) {
+        const AVStream *srcStream = src->streams[i];
+        AVStream *dstStream = avformat_new_stream(dst, nullptr);
+        CHECK_AND_RETURN_RET_LOG(dstStream != nullptr, Status::ERROR_NO_MEMORY, "avformat_new_stream failed!");
+        CHECK_AND_RETURN_RET_LOG(avcodec_parameters_copy(dstStream->codecpar, srcStream->codecpar) >= 0,
+            Status::ERROR_NO_MEMORY, "copy the codec parameters failed!");
+        // the tag chosen for the previous file is chosen again by the header.
+        dstStream->codecpar->codec_tag = 0;
+        dstStream->time_base = srcStream->time_base;
+        dstStream->disposition = srcStream->disposition;
+        (void)av_dict_copy(&dstStream->metadata, srcStream->metadata, 0);
+    }
+    return Status::NO_ERROR;
+}
+
 FFmpegMuxerPlugin::~FFmpegMuxerPlugin()
 {
     AVCODEC_LOGD("Destory");
     outputFormat_.reset();
     cachePacket_.reset();
     formatContext_.reset();
+    // the preallocated space is given back through the fd, before it is closed.
+    preallocator_ = nullptr;
     CloseFd();
     AVCODEC_LOGD("0x%{public}06" PRIXPTR " Instances destroy", FAKE_POINTER(this));
 }
@@ -170,6 +255,76 @@ Status FFmpegMuxerPlugin::SetRotation(int32_t rotation)
     return Status::NO_ERROR;
 }
 
+Status FFmpegMuxerPlugin::SetParameter(const MediaDescription &param)
+{
+    // a key that is not given keeps the value of an earlier call.
+    int64_t fragmentDurationUs = fragmentDurationUs_;
+    param.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_FRAGMENT_DURATION, fragmentDurationUs);
+    CHECK_AND_RETURN_RET_LOG(fragmentDurationUs >= 0, Status::ERROR_INVALID_PARAMETER,
+        "fragment duration %{public}" PRId64 " is invalid!", fragmentDurationUs);
+    fragmentDurationUs_ = fragmentDurationUs;
+
+    int64_t expectedDurationUs = expectedDurationUs_;
+    int64_t moovSize = moovSize_;
+    param.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_EXPECTED_DURATION, expectedDurationUs);
+    param.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_MOOV_SIZE, moovSize);
+    // the moov_size option of the mov muxer is an int.
+    CHECK_AND_RETURN_RET_LOG(expectedDurationUs >= 0 && moovSize >= 0 && moovSize <= INT32_MAX,
+        Status::ERROR_INVALID_PARAMETER,
+        "expected duration %{public}" PRId64 " or moov size %{public}" PRId64 " is invalid!",
+        expectedDurationUs, moovSize);
+    expectedDurationUs_ = expectedDurationUs;
+    moovSize_ = moovSize;
+
+    int64_t expectedSize = expectedSize_;
+    param.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_EXPECTED_SIZE, expectedSize);
+    CHECK_AND_RETURN_RET_LOG(expectedSize >= 0, Status::ERROR_INVALID_PARAMETER,
+        "expected size %{public}" PRId64 " is invalid!", expectedSize);
+    expectedSize_ = expectedSize;
+
+    int32_t directWriteThreshold = directWriteThreshold_;
+    param.GetIntValue(MediaDescriptionKey::MD_KEY_MUXER_DIRECT_WRITE_THRESHOLD, directWriteThreshold);
+    CHECK_AND_RETURN_RET_LOG(directWriteThreshold >= 0, Status::ERROR_INVALID_PARAMETER,
+        "direct write threshold %{public}d is invalid!", directWriteThreshold);
+    directWriteThreshold_ = directWriteThreshold;
+
+    int32_t writeBehindBuffers = writeBehindBuffers_;
+    param.GetIntValue(MediaDescriptionKey::MD_KEY_MUXER_WRITE_BEHIND_BUFFERS, writeBehindBuffers);
+    CHECK_AND_RETURN_RET_LOG(writeBehindBuffers >= 0 && writeBehindBuffers <= MAX_WRITE_BEHIND_BUFFERS,
+        Status::ERROR_INVALID_PARAMETER, "write behind buffers %{public}d is invalid!", writeBehindBuffers);
+    writeBehindBuffers_ = writeBehindBuffers;
+
+    int64_t writebackInterval = writebackInterval_;
+    param.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_WRITEBACK_INTERVAL, writebackInterval);
+    CHECK_AND_RETURN_RET_LOG(writebackInterval == 0 || writebackInterval >= MIN_WRITEBACK_INTERVAL,
+        Status::ERROR_INVALID_PARAMETER, "writeback interval %{public}" PRId64 " is invalid!", writebackInterval);
+    writebackInterval_ = writebackInterval;
+
+    int32_t directIo = directIo_ ? 1 : 0;
+    param.GetIntValue(MediaDescriptionKey::MD_KEY_MUXER_DIRECT_IO, directIo);
+    directIo_ = directIo != 0;
+
+    int32_t ioBufferSize = 0;
+    if (param.GetIntValue(MediaDescriptionKey::MD_KEY_MUXER_IO_BUFFER_SIZE, ioBufferSize) ||
+        param.ContainKey(MediaDescriptionKey::MD_KEY_MUXER_DIRECT_IO)) {
+        ioBufferSize = ioBufferSize > 0 ? ioBufferSize : formatContext_->pb->buffer_size;
+        CHECK_AND_RETURN_RET_LOG(ioBufferSize > 0 && ioBufferSize <= MAX_IO_BUFFER_SIZE,
+            Status::ERROR_INVALID_PARAMETER, "io buffer size %{public}d is invalid!", ioBufferSize);
+        ioBufferSize = AlignIoBufferSize(fd_, ioBufferSize);
+        if (directIo_) {
+            // the direct writes are made of whole io buffers.
+            ioBufferSize = (ioBufferSize + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT * DIRECT_IO_ALIGNMENT;
+        }
+        Status ret = ResetAvIoCtx(ioBufferSize);
+        CHECK_AND_RETURN_RET_LOG(ret == Status::NO_ERROR, ret, "reset io context failed!");
+    }
+
+    int32_t asyncIo = asyncIo_ ? 1 : 0;
+    param.GetIntValue(MediaDescriptionKey::MD_KEY_MUXER_ASYNC_IO, asyncIo);
+    SetAsyncIo(asyncIo != 0);
+    return Status::NO_ERROR;
+}
+
 Status FFmpegMuxerPlugin::SetCodecParameterOfTrack(AVStream *stream, const MediaDescription &trackDesc)
 {
     constexpr int32_t mimeTypeLen = 5;
@@ -234,6 +389,15 @@ Status FFmpegMuxerPlugin::AddTrack(int32_t &trackIndex, const MediaDescription &
     ResetCodecParameter(st->codecpar);
     Status ret = SetCodecParameterOfTrack(st, trackDesc);
     CHECK_AND_RETURN_RET_LOG(ret == Status::NO_ERROR, ret, "SetCodecParameter failed!");
+    double frameRate = 0.0;
+    if (trackDesc.GetDoubleValue(MediaDescriptionKey::MD_KEY_FRAME_RATE, frameRate) && frameRate > 0.0) {
+        frameRates_[trackIndex] = frameRate;
+    }
+    int64_t durationUs = 0;
+    if (trackDesc.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_EXPECTED_DURATION, durationUs) && durationUs > 0) {
+        // a hint of this track only, such as a commentary that ends before the video.
+        trackDurations_[trackIndex] = durationUs;
+    }
     formatContext_->flags |= AVFMT_TS_NONSTRICT;
     return Status::NO_ERROR;
 }
@@ -248,30 +412,199 @@ Status FFmpegMuxerPlugin::Start()
             }
         }
     }
+    trackSamples_.assign(formatContext_->nb_streams, 0);
+    writtenBytes_ = 0;
     AVDictionary *options = nullptr;
-    av_dict_set(&options, "movflags", "faststart", 0);
+    SetMovFlags(&options);
+    SetWriteback();
+    SetWriteBehind();
+    preallocator_ = nullptr;
+    if (expectedSize_ > 0 || expectedDurationUs_ > 0 || !trackDurations_.empty()) {
+        int64_t expectedBytes = GetExpectedBytes();
+        int64_t chunkSize = expectedBytes > 0 ? std::clamp(expectedBytes / PREALLOCATE_CHUNKS,
+            MIN_PREALLOCATE_CHUNK, MAX_PREALLOCATE_CHUNK) : DEFAULT_PREALLOCATE_CHUNK;
+        preallocator_ = std::make_unique<MuxerPreallocator>(fd_, chunkSize);
+    }
     int ret = avformat_write_header(formatContext_.get(), &options);
+    av_dict_free(&options);
     if (ret < 0) {
         AVCODEC_LOGE("write header failed, %{public}s", AVStrError(ret).c_str());
         return Status::ERROR_UNKNOWN;
     }
+    Preallocate();
     return Status::NO_ERROR;
 }
 
+void FFmpegMuxerPlugin::SetMovFlags(AVDictionary **options)
+{
+    if (fragmentDurationUs_ <= 0 && (moovSize_ > 0 || expectedDurationUs_ > 0 || !trackDurations_.empty())) {
+        std::vector<int64_t> expectedSamples;
+        for (uint32_t i = 0; i < formatContext_->nb_streams; i++) {
+            expectedSamples.push_back(GetExpectedSamples(i));
+        }
+        int64_t estimated = EstimateMoovSize(expectedSamples, GetExpectedBytes() > UINT32_MAX);
+        reservedMoovSize_ = moovSize_ > 0 ? moovSize_ :
+            std::min<int64_t>(estimated + estimated / MOOV_MARGIN_DIVISOR, INT32_MAX);
+        AVCODEC_LOGI("reserve %{public}" PRId64 " bytes for moov", reservedMoovSize_);
+        av_dict_set_int(options, "moov_size", reservedMoovSize_, 0);
+        return;
+    }
+    reservedMoovSize_ = 0;
+    if (fragmentDurationUs_ <= 0) {
+        av_dict_set(options, "movflags", "faststart", 0);
+        return;
+    }
+    // each fragment carries its own sample tables, so Stop() only flushes the last fragment and the
+    // memory of the tables does not grow with the recording.
+    bool hasVideo = false;
+    for (uint32_t i = 0; i < formatContext_->nb_streams; i++) {
+        auto stream = formatContext_->streams[i];
+        if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO &&
+            (static_cast<uint32_t>(stream->disposition) & AV_DISPOSITION_ATTACHED_PIC) == 0) {
+            hasVideo = true;
+        }
+    }
+    if (hasVideo) {
+        // start the fragments at sync frames, so that each of them can be decoded independently.
+        av_dict_set(options, "movflags", "empty_moov+default_base_moof+frag_keyframe", 0);
+        av_dict_set_int(options, "min_frag_duration", fragmentDurationUs_, 0);
+    } else {
+        av_dict_set(options, "movflags", "empty_moov+default_base_moof", 0);
+        av_dict_set_int(options, "frag_duration", fragmentDurationUs_, 0);
+    }
+}
+
+int64_t FFmpegMuxerPlugin::GetExpectedBytes()
+{
+    if (expectedSize_ > 0) {
+        return expectedSize_;
+    }
+    int64_t expectedBytes = 0;
+    for (uint32_t i = 0; i < formatContext_->nb_streams; i++) {
+        expectedBytes += formatContext_->streams[i]->codecpar->bit_rate / BYTE_BITS *
+            GetExpectedDuration(i) / USEC_PER_SEC;
+    }
+    return expectedBytes;
+}
+
+void FFmpegMuxerPlugin::Preallocate()
+{
+    if (preallocator_ == nullptr) {
+        return;
+    }
+    int64_t end = std::max(*static_cast<IOContext*>(formatContext_->pb->opaque)->end_, avio_tell(formatContext_->pb));
+    preallocator_->OnWritten(end);
+}
+
+int64_t FFmpegMuxerPlugin::GetExpectedDuration(uint32_t trackIndex)
+{
+    auto it = trackDurations_.find(static_cast<int32_t>(trackIndex));
+    return it != trackDurations_.end() ? it->second : expectedDurationUs_;
+}
+
+int64_t FFmpegMuxerPlugin::GetExpectedSamples(uint32_t trackIndex)
+{
+    int64_t durationUs = GetExpectedDuration(trackIndex);
+    auto stream = formatContext_->streams[trackIndex];
+    if ((static_cast<uint32_t>(stream->disposition) & AV_DISPOSITION_ATTACHED_PIC) != 0) {
+        return 1;
+    }
+    if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        auto it = frameRates_.find(static_cast<int32_t>(trackIndex));
+        double frameRate = it != frameRates_.end() ? it->second : DEFAULT_FRAME_RATE;
+        return static_cast<int64_t>(frameRate * durationUs / USEC_PER_SEC) + 1;
+    }
+    if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+        return stream->codecpar->sample_rate * durationUs / USEC_PER_SEC / AUDIO_FRAME_SAMPLES + 1;
+    }
+    return OTHER_SAMPLE_RATE * durationUs / USEC_PER_SEC + 1;
+}
+
+int64_t FFmpegMuxerPlugin::EstimateMoovSize(const std::vector<int64_t> &trackSamples, bool largeFile)
+{
+    int64_t offsetSize = largeFile ? MOOV_LARGE_CHUNK_OFFSET_SIZE : MOOV_CHUNK_OFFSET_SIZE;
+    int64_t size = MOOV_MOVIE_OVERHEAD;
+    for (uint32_t i = 0; i < formatContext_->nb_streams && i < trackSamples.size(); i++) {
+        auto par = formatContext_->streams[i]->codecpar;
+        int64_t sampleSize = par->codec_type == AVMEDIA_TYPE_VIDEO ? MOOV_VIDEO_SAMPLE_SIZE : MOOV_AUDIO_SAMPLE_SIZE;
+        size += MOOV_TRACK_OVERHEAD + par->extradata_size + trackSamples[i] * (sampleSize + offsetSize);
+    }
+    return size;
+}
+
+void FFmpegMuxerPlugin::ReleaseReservedMoov()
+{
+    // the moov goes to the end of the file, the reserved space right after the ftyp becomes a free box.
+    uint8_t header[BOX_HEADER_SIZE] = {0};
+    ssize_t size = pread(fd_, header, sizeof(uint32_t), 0);
+    CHECK_AND_RETURN_LOG(size == sizeof(uint32_t), "read ftyp failed");
+    uint32_t ftypSize = (static_cast<uint32_t>(header[0]) << 24) | (static_cast<uint32_t>(header[1]) << 16) | // 24 16
+        (static_cast<uint32_t>(header[2]) << 8) | static_cast<uint32_t>(header[3]); // 2 8 3
+    uint32_t freeSize = static_cast<uint32_t>(reservedMoovSize_);
+    header[0] = static_cast<uint8_t>(freeSize >> 24); // 24
+    header[1] = static_cast<uint8_t>(freeSize >> 16); // 16
+    header[2] = static_cast<uint8_t>(freeSize >> 8); // 2 8
+    header[3] = static_cast<uint8_t>(freeSize); // 3
+    header[4] = 'f'; // 4
+    header[5] = 'r'; // 5
+    header[6] = 'e'; // 6
+    header[7] = 'e'; // 7
+    size = pwrite(fd_, header, sizeof(header), ftypSize);
+    CHECK_AND_RETURN_LOG(size == sizeof(header), "write free box failed");
+}
+
 Status FFmpegMuxerPlugin::Stop()
 {
+    Status status = Status::NO_ERROR;
     int ret = av_write_frame(formatContext_.get(), nullptr); // flush out cache data
     if (ret < 0) {
         AVCODEC_LOGE("write trailer failed, %{public}s", AVStrError(ret).c_str());
+        status = Status::ERROR_UNKNOWN;
+    }
+    bool moovOverflow = false;
+    if (reservedMoovSize_ > 0) {
+        int64_t needed = EstimateMoovSize(trackSamples_, writtenBytes_ > UINT32_MAX);
+        if (needed > reservedMoovSize_) {
+            // the file is still valid with the moov at the end, it is only not optimized for streaming.
+            AVCODEC_LOGW("moov may need %{public}" PRId64 " bytes, more than the reserved %{public}" PRId64
+                ", write it at the end", needed, reservedMoovSize_);
+            av_opt_set_int(formatContext_->priv_data, "moov_size", 0, 0);
+            moovOverflow = true;
+        }
     }
     ret = av_write_trailer(formatContext_.get());
     if (ret != 0) {
         AVCODEC_LOGE("write trailer failed, %{public}s", AVStrError(ret).c_str());
+        status = Status::ERROR_UNKNOWN;
     }
     avio_flush(formatContext_->pb);
+    if (!DrainAsyncWrite(static_cast<IOContext*>(formatContext_->pb->opaque))) {
+        AVCODEC_LOGE("write file failed");
+        status = Status::ERROR_UNKNOWN;
+    }
+    auto writeback = std::atomic_load(&writeback_);
+    if (writeback != nullptr) {
+        // only handed to the writeback thread to start, the app decides whether to wait for it with fsync.
+        writeback->Flush();
+    }
+    auto writeBehind = std::atomic_load(&writeBehind_);
+    if (writeBehind != nullptr) {
+        auto stats = writeBehind->GetStatistics();
+        AVCODEC_LOGI("io stage wrote %{public}" PRId64 " bytes in %{public}" PRId64 " us, max %{public}" PRId64
+            " us per write, mux stage stalled %{public}" PRId64 " us", stats.bytes, stats.ioTimeUs,
+            stats.maxIoTimeUs, stats.stallTimeUs);
+    }
+    if (moovOverflow) {
+        ReleaseReservedMoov();
+    }
+    if (preallocator_ != nullptr) {
+        preallocator_->Release();
+        preallocator_ = nullptr;
+    }
 
+    // the file is closed either way, a failed one is not written again.
     CloseFd();
-    return Status::NO_ERROR;
+    return status;
 }
 
 Status FFmpegMuxerPlugin::WriteSampleBuffer(uint8_t *sampleBuffer, const TrackSampleInfo &info)
@@ -284,30 +617,168 @@ Status FFmpegMuxerPlugin::WriteSampleBuffer(uint8_t *sampleBuffer, const TrackSa
     cachePacket_->data = sampleBuffer;
     cachePacket_->size = info.size;
     cachePacket_->stream_index = static_cast<int>(info.trackIndex);
-    cachePacket_->pts = ConvertTimeToFFmpeg(info.timeUs, formatContext_->streams[info.trackIndex]->time_base);
-    cachePacket_->dts = cachePacket_->pts;
+    if (rebaseTime_) {
+        // a switched output starts from the sample it was switched at.
+        timeOffsetUs_ = info.decodeTimeUs == SAMPLE_TIME_NONE ? info.timeUs : info.decodeTimeUs;
+        rebaseTime_ = false;
+    }
+    cachePacket_->pts = ConvertTimeToFFmpeg(info.timeUs - timeOffsetUs_,
+        formatContext_->streams[info.trackIndex]->time_base);
+    // the mov muxer writes the composition offsets (ctts) from the difference between pts and dts.
+    cachePacket_->dts = info.decodeTimeUs == SAMPLE_TIME_NONE ? cachePacket_->pts :
+        ConvertTimeToFFmpeg(info.decodeTimeUs - timeOffsetUs_, formatContext_->streams[info.trackIndex]->time_base);
     cachePacket_->flags = 0;
     if (info.flags & AVCODEC_BUFFER_FLAG_SYNC_FRAME) {
         AVCODEC_LOGD("It is key frame");
         cachePacket_->flags |= AV_PKT_FLAG_KEY;
     }
+    bool directWrite = directWriteThreshold_ > 0 && info.size >= static_cast<uint32_t>(directWriteThreshold_);
+    if (directWrite) {
+        SetDirectWrite(true);
+    }
     auto ret = av_write_frame(formatContext_.get(), cachePacket_.get());
+    if (directWrite) {
+        SetDirectWrite(false);
+    }
     av_packet_unref(cachePacket_.get());
     if (ret < 0) {
         AVCODEC_LOGE("write sample buffer failed, %{public}s", AVStrError(ret).c_str());
         return Status::ERROR_UNKNOWN;
     }
+    if (info.trackIndex < trackSamples_.size()) {
+        trackSamples_[info.trackIndex]++;
+    }
+    writtenBytes_ += info.size;
+    Preallocate();
     return Status::NO_ERROR;
 }
 
-AVIOContext *FFmpegMuxerPlugin::InitAvIoCtx(int32_t fd, int writeFlags)
+void FFmpegMuxerPlugin::SetDirectWrite(bool enable)
+{
+    // a direct AVIO context flushes what it has buffered and then hands the payload to IoWrite without
+    // copying it, IoWrite sends both with one pwritev.
+    AVIOContext *pb = formatContext_->pb;
+    auto ioCtx = static_cast<IOContext*>(pb->opaque);
+    pb->direct = enable ? 1 : 0;
+    ioCtx->coalesce_ = enable;
+    if (!enable && !FlushPendingWrite(ioCtx)) {
+        pb->error = AVERROR(EIO);
+    }
+}
+
+Status FFmpegMuxerPlugin::GetStatistics(MediaDescription &stats)
+{
+    auto writeBehind = std::atomic_load(&writeBehind_);
+    if (writeBehind != nullptr) {
+        auto ioStats = writeBehind->GetStatistics();
+        stats.PutIntValue("write_behind_buffers", writeBehindBuffers_);
+        stats.PutLongValue("io_stage_writes", ioStats.writes);
+        stats.PutLongValue("io_stage_bytes", ioStats.bytes);
+        stats.PutLongValue("io_stage_time_us", ioStats.ioTimeUs);
+        stats.PutLongValue("io_stage_max_time_us", ioStats.maxIoTimeUs);
+        stats.PutLongValue("mux_stage_stall_time_us", ioStats.stallTimeUs);
+        stats.PutLongValue("direct_io_bytes", ioStats.directBytes);
+    }
+    auto writeback = std::atomic_load(&writeback_);
+    if (writeback != nullptr) {
+        auto wbStats = writeback->GetStatistics();
+        stats.PutLongValue("writeback_interval_bytes", wbStats.intervalBytes);
+        stats.PutLongValue("writeback_dirty_bytes", wbStats.dirtyBytes);
+        stats.PutLongValue("writeback_in_flight_bytes", wbStats.inFlightBytes);
+        stats.PutLongValue("writeback_synced_bytes", wbStats.syncedBytes);
+        stats.PutLongValue("writeback_wait_time_us", wbStats.waitTimeUs);
+    }
+    return Status::NO_ERROR;
+}
+
+void FFmpegMuxerPlugin::SetWriteback()
+{
+    auto ioCtx = static_cast<IOContext*>(formatContext_->pb->opaque);
+    if (writebackInterval_ == 0) {
+        return;
+    }
+    if (ioCtx->writeback_ == nullptr) {
+        ioCtx->writeback_ = std::make_shared<MuxerWriteback>(fd_, writebackInterval_);
+    }
+    std::atomic_store(&writeback_, ioCtx->writeback_);
+}
+
+void FFmpegMuxerPlugin::SetWriteBehind()
+{
+    // io_uring already keeps the writes off the mux thread, the direct io needs the aligned blocks of the
+    // write behind thread though.
+    auto ioCtx = static_cast<IOContext*>(formatContext_->pb->opaque);
+    if (directIo_) {
+        ioCtx->uring_ = nullptr;
+    } else if (ioCtx->uring_ != nullptr || writeBehindBuffers_ == 0) {
+        return;
+    }
+    int32_t writeBehindBuffers = writeBehindBuffers_ > 0 ? writeBehindBuffers_ : DIRECT_IO_WRITE_BEHIND_BUFFERS;
+    if (ioCtx->writeBehind_ == nullptr) {
+        std::shared_ptr<MuxerWriteback> writeback = ioCtx->writeback_;
+        MuxerWriteBehind::WrittenCallback onWritten = nullptr;
+        if (writeback != nullptr) {
+            onWritten = [writeback](int64_t pos, size_t size) { writeback->OnWritten(pos, size); };
+        }
+        ioCtx->writeBehind_ = MuxerWriteBehind::Create(fd_, static_cast<uint32_t>(writeBehindBuffers),
+            static_cast<uint32_t>(formatContext_->pb->buffer_size), onWritten);
+        if (ioCtx->writeBehind_ != nullptr && directIo_ && !ioCtx->writeBehind_->EnableDirectIo()) {
+            AVCODEC_LOGW("direct io is not available, write through the page cache");
+        }
+    }
+    std::atomic_store(&writeBehind_, ioCtx->writeBehind_);
+}
+
+void FFmpegMuxerPlugin::SetAsyncIo(bool enable)
+{
+    // called before Start, nothing is in flight yet.
+    asyncIo_ = enable;
+    auto ioCtx = static_cast<IOContext*>(formatContext_->pb->opaque);
+    if (!enable) {
+        ioCtx->uring_ = nullptr;
+        return;
+    }
+    uint32_t bufferSize = static_cast<uint32_t>(formatContext_->pb->buffer_size);
+    if (ioCtx->uring_ == nullptr) {
+        ioCtx->uring_ = MuxerIoUring::Create(fd_, ASYNC_IO_DEPTH, bufferSize);
+    }
+    AVCODEC_LOGI("async io %{public}s",
+        ioCtx->uring_ != nullptr ? "enabled" : "not supported, write synchronously");
+}
+
+Status FFmpegMuxerPlugin::ResetAvIoCtx(int32_t bufferSize)
+{
+    // nothing has been written before Start, so the context can simply be replaced.
+    AVIOContext *pb = formatContext_->pb;
+    if (pb != nullptr && pb->buffer_size == bufferSize) {
+        return Status::NO_ERROR;
+    }
+    AVIOContext *newPb = InitAvIoCtx(fd_, 1, bufferSize, std::make_shared<int64_t>(0));
+    CHECK_AND_RETURN_RET_LOG(newPb != nullptr, Status::ERROR_NO_MEMORY, "alloc avio context failed!");
+    DeInitAvIoCtx(pb);
+    formatContext_->pb = newPb;
+    AVCODEC_LOGI("io buffer size %{public}d", bufferSize);
+    return Status::NO_ERROR;
+}
+
+int32_t FFmpegMuxerPlugin::AlignIoBufferSize(int32_t fd, int32_t size)
+{
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_blksize <= 0 || fileStat.st_blksize > size) {
+        return size;
+    }
+    int32_t blockSize = static_cast<int32_t>(fileStat.st_blksize);
+    return (size + blockSize - 1) / blockSize * blockSize;
+}
+
+AVIOContext *FFmpegMuxerPlugin::InitAvIoCtx(int32_t fd, int writeFlags, int32_t bufferSize,
+    std::shared_ptr<int64_t> end)
 {
     IOContext *ioContext = new IOContext();
     ioContext->fd_ = fd;
     ioContext->pos_ = 0;
-    ioContext->end_ = 0;
+    ioContext->end_ = end;
 
-    constexpr int bufferSize = 4 * 1024; // 4096
     auto buffer = static_cast<unsigned char*>(av_malloc(bufferSize));
     AVIOContext *avioContext = avio_alloc_context(buffer, bufferSize, writeFlags, static_cast<void*>(ioContext),
                                                   IoRead, IoWrite, IoSeek);
@@ -343,48 +814,144 @@ void FFmpegMuxerPlugin::CloseFd()
 int32_t FFmpegMuxerPlugin::IoRead(void *opaque, uint8_t *buf, int bufSize)
 {
     auto ioCtx = static_cast<IOContext*>(opaque);
-    if (ioCtx && ioCtx->fd_ != -1) {
-        int64_t ret = lseek(ioCtx->fd_, ioCtx->pos_, SEEK_SET);
-        if (ret != -1) {
-            ssize_t size = read(ioCtx->fd_, buf, bufSize);
-            if (size < 0) {
-                return -1;
-            }
-            ioCtx->pos_ += size;
-            if (ioCtx->pos_ > ioCtx->end_) {
-                ioCtx->end_ = ioCtx->pos_;
-            }
-            return size;
-        }
-        return 0;
+    if (ioCtx == nullptr || ioCtx->fd_ == -1) {
+        return -1;
+    }
+    if (!DrainAsyncWrite(ioCtx)) {
+        return -1;
+    }
+    ssize_t size = 0;
+    do {
+        size = pread(ioCtx->fd_, buf, bufSize, ioCtx->pos_);
+    } while (size < 0 && errno == EINTR);
+    if (size < 0) {
+        return -1;
+    }
+    if (size == 0) {
+        return AVERROR_EOF;
     }
-    return -1;
+    ioCtx->pos_ += size;
+    return size;
 }
 
 int32_t FFmpegMuxerPlugin::IoWrite(void *opaque, uint8_t *buf, int bufSize)
 {
     auto ioCtx = static_cast<IOContext*>(opaque);
-    if (ioCtx && ioCtx->fd_ != -1) {
-        int64_t ret = lseek(ioCtx->fd_, ioCtx->pos_, SEEK_SET);
-        if (ret != -1) {
-            ssize_t size = write(ioCtx->fd_, buf, bufSize);
-            if (size < 0) {
-                return -1;
-            }
-            ioCtx->pos_ += size;
-            if (ioCtx->pos_ > ioCtx->end_) {
-                ioCtx->end_ = ioCtx->pos_;
-            }
-            return size;
+    if (ioCtx == nullptr || ioCtx->fd_ == -1) {
+        return -1;
+    }
+    if (ioCtx->coalesce_ && ioCtx->pending_.empty() && bufSize <= MAX_PENDING_WRITE_SIZE) {
+        // hold the box bytes flushed ahead of a direct payload, they are written together with it.
+        ioCtx->pending_.assign(buf, buf + bufSize);
+        ioCtx->pendingPos_ = ioCtx->pos_;
+    } else {
+        struct iovec iov[MAX_WRITE_IOV_COUNT];
+        int32_t iovCount = 0;
+        int64_t pos = ioCtx->pos_;
+        if (!ioCtx->pending_.empty() &&
+            ioCtx->pendingPos_ + static_cast<int64_t>(ioCtx->pending_.size()) == ioCtx->pos_) {
+            iov[iovCount++] = {ioCtx->pending_.data(), ioCtx->pending_.size()};
+            pos = ioCtx->pendingPos_;
+        } else if (!FlushPendingWrite(ioCtx)) {
+            return -1;
         }
-        return 0;
+        iov[iovCount++] = {buf, static_cast<size_t>(bufSize)};
+        // positional writes do not depend on the file offset, which is shared with the other contexts of the fd.
+        if (!WriteOut(ioCtx, iov, iovCount, pos)) {
+            return -1;
+        }
+        ioCtx->pending_.clear();
+    }
+    ioCtx->pos_ += bufSize;
+    if (ioCtx->pos_ > *ioCtx->end_) {
+        *ioCtx->end_ = ioCtx->pos_;
+    }
+    return bufSize;
+}
+
+bool FFmpegMuxerPlugin::WriteFully(int32_t fd, struct iovec *iov, int32_t iovCount, int64_t pos)
+{
+    while (iovCount > 0) {
+        ssize_t size = pwritev(fd, iov, iovCount, pos);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            AVCODEC_LOGE("write file failed, errno %{public}d", errno);
+            return false;
+        }
+        pos += size;
+        while (iovCount > 0 && static_cast<size_t>(size) >= iov->iov_len) {
+            size -= static_cast<ssize_t>(iov->iov_len);
+            iov++;
+            iovCount--;
+        }
+        if (iovCount > 0) {
+            iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + size;
+            iov->iov_len -= static_cast<size_t>(size);
+        }
+    }
+    return true;
+}
+
+bool FFmpegMuxerPlugin::FlushPendingWrite(IOContext *ioCtx)
+{
+    if (ioCtx->pending_.empty()) {
+        return true;
     }
-    return -1;
+    struct iovec iov = {ioCtx->pending_.data(), ioCtx->pending_.size()};
+    bool ret = WriteOut(ioCtx, &iov, 1, ioCtx->pendingPos_);
+    ioCtx->pending_.clear();
+    return ret;
+}
+
+bool FFmpegMuxerPlugin::WriteOut(IOContext *ioCtx, struct iovec *iov, int32_t iovCount, int64_t pos)
+{
+    size_t size = 0;
+    for (int32_t i = 0; i < iovCount; i++) {
+        size += iov[i].iov_len;
+    }
+    if (ioCtx->uring_ == nullptr && ioCtx->writeBehind_ == nullptr) {
+        bool ret = WriteFully(ioCtx->fd_, iov, iovCount, pos);
+        if (ret && ioCtx->writeback_ != nullptr) {
+            ioCtx->writeback_->OnWritten(pos, size);
+        }
+        return ret;
+    }
+    int64_t start = pos;
+    for (int32_t i = 0; i < iovCount; i++) {
+        auto data = static_cast<const uint8_t *>(iov[i].iov_base);
+        bool ret = ioCtx->uring_ != nullptr ? ioCtx->uring_->Write(data, iov[i].iov_len, pos) :
+            ioCtx->writeBehind_->Write(data, iov[i].iov_len, pos);
+        if (!ret) {
+            AVCODEC_LOGE("async write file failed");
+            return false;
+        }
+        pos += static_cast<int64_t>(iov[i].iov_len);
+    }
+    // the write behind thread reports its own writes, the io_uring ones are only queued here, starting their
+    // writeback early does no harm, it just finds fewer dirty pages.
+    if (ioCtx->uring_ != nullptr && ioCtx->writeback_ != nullptr) {
+        ioCtx->writeback_->OnWritten(start, size);
+    }
+    return true;
+}
+
+bool FFmpegMuxerPlugin::DrainAsyncWrite(IOContext *ioCtx)
+{
+    if (ioCtx == nullptr) {
+        return true;
+    }
+    bool ret = ioCtx->uring_ == nullptr || ioCtx->uring_->Drain();
+    return (ioCtx->writeBehind_ == nullptr || ioCtx->writeBehind_->Drain()) && ret;
 }
 
 int64_t FFmpegMuxerPlugin::IoSeek(void *opaque, int64_t offset, int whence)
 {
     auto ioContext = static_cast<IOContext*>(opaque);
+    if (!FlushPendingWrite(ioContext)) {
+        return AVERROR(EIO);
+    }
     uint64_t newPos = 0;
     switch (whence) {
         case SEEK_SET:
@@ -396,13 +963,19 @@ int64_t FFmpegMuxerPlugin::IoSeek(void *opaque, int64_t offset, int whence)
             break;
         case SEEK_END:
         case AVSEEK_SIZE:
-            newPos = ioContext->end_ + offset;
+            newPos = *ioContext->end_ + offset;
             break;
         default:
             break;
     }
     if (whence != AVSEEK_SIZE) {
         ioContext->pos_ = newPos;
+        // the writes in flight may complete in any order, let them land before any of them is overwritten.
+        // the write behind thread writes in order, it needs no drain.
+        if (ioContext->uring_ != nullptr && static_cast<int64_t>(newPos) < *ioContext->end_ &&
+            !ioContext->uring_->Drain()) {
+            return AVERROR(EIO);
+        }
     }
     return newPos;
 }
@@ -411,7 +984,14 @@ int32_t FFmpegMuxerPlugin::IoOpen(AVFormatContext *s, AVIOContext **pb,
                                   const char *url, int flags, AVDictionary **options)
 {
     AVCODEC_LOGD("IoOpen flags %{public}d", flags);
-    *pb = InitAvIoCtx(static_cast<IOContext*>(s->pb->opaque)->fd_, 0);
+    auto ioCtx = static_cast<IOContext*>(s->pb->opaque);
+    *pb = InitAvIoCtx(ioCtx->fd_, 0, s->pb->buffer_size, ioCtx->end_);
+    if (*pb == nullptr) {
+        return AVERROR(ENOMEM);
+    }
+    static_cast<IOContext*>((*pb)->opaque)->uring_ = ioCtx->uring_;
+    static_cast<IOContext*>((*pb)->opaque)->writeBehind_ = ioCtx->writeBehind_;
+    static_cast<IOContext*>((*pb)->opaque)->writeback_ = ioCtx->writeback_;
     return 0;
 }
 
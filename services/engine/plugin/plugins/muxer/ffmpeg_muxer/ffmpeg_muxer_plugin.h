@@ -16,7 +16,14 @@
 #ifndef FFMPEG_MUXER_PLUGIN_H
 #define FFMPEG_MUXER_PLUGIN_H
 
+#include <map>
+#include <vector>
+#include <sys/uio.h>
 #include "muxer_plugin.h"
+#include "muxer_io_uring.h"
+#include "muxer_preallocator.h"
+#include "muxer_write_behind.h"
+#include "muxer_writeback.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -38,33 +45,80 @@ public:
 
     Status SetLocation(float latitude, float longitude) override;
     Status SetRotation(int32_t rotation) override;
+    Status SetParameter(const MediaDescription &param) override;
     Status AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc) override;
     Status Start() override;
     Status WriteSampleBuffer(uint8_t *sampleBuffer, const TrackSampleInfo &info) override;
     Status Stop() override;
+    Status GetStatistics(MediaDescription &stats) override;
+    Status SwitchOutput(int32_t fd) override;
 
 private:
     Status SetCodecParameterOfTrack(AVStream *stream, const MediaDescription &trackDesc);
+    std::shared_ptr<AVFormatContext> CreateFormatContext(int32_t bufferSize);
+    Status CopyStreams(AVFormatContext *dst, const AVFormatContext *src);
     static int32_t IoRead(void *opaque, uint8_t *buf, int bufSize);
     static int32_t IoWrite(void *opaque, uint8_t *buf, int bufSize);
     static int64_t IoSeek(void *opaque, int64_t offset, int whence);
-    static AVIOContext *InitAvIoCtx(int32_t fd, int writeFlags);
+    static AVIOContext *InitAvIoCtx(int32_t fd, int writeFlags, int32_t bufferSize, std::shared_ptr<int64_t> end);
+    static int32_t AlignIoBufferSize(int32_t fd, int32_t size);
+    Status ResetAvIoCtx(int32_t bufferSize);
+    void SetDirectWrite(bool enable);
+    void SetAsyncIo(bool enable);
+    void SetWriteBehind();
+    void SetWriteback();
     static void DeInitAvIoCtx(AVIOContext *ptr);
     static int32_t IoOpen(AVFormatContext *s, AVIOContext **pb, const char *url, int flags, AVDictionary **options);
     static void IoClose(AVFormatContext *s, AVIOContext *pb);
     void CloseFd();
+    void SetMovFlags(AVDictionary **options);
+    int64_t EstimateMoovSize(const std::vector<int64_t> &trackSamples, bool largeFile);
+    int64_t GetExpectedDuration(uint32_t trackIndex);
+    int64_t GetExpectedSamples(uint32_t trackIndex);
+    int64_t GetExpectedBytes();
+    void Preallocate();
+    void ReleaseReservedMoov();
 
 private:
     struct IOContext {
         int32_t fd_ {-1};
         int64_t pos_ {0};
-        int64_t end_ {0};
+        std::shared_ptr<int64_t> end_ {nullptr}; // shared by the contexts of the same fd
+        bool coalesce_ {false};
+        std::vector<uint8_t> pending_ {};
+        int64_t pendingPos_ {0};
+        std::shared_ptr<MuxerIoUring> uring_ {nullptr}; // shared by the contexts of the same fd
+        std::shared_ptr<MuxerWriteBehind> writeBehind_ {nullptr}; // shared by the contexts of the same fd
+        std::shared_ptr<MuxerWriteback> writeback_ {nullptr}; // shared by the contexts of the same fd
     };
+    static bool WriteFully(int32_t fd, struct iovec *iov, int32_t iovCount, int64_t pos);
+    static bool WriteOut(IOContext *ioCtx, struct iovec *iov, int32_t iovCount, int64_t pos);
+    static bool DrainAsyncWrite(IOContext *ioCtx);
+    static bool FlushPendingWrite(IOContext *ioCtx);
     int32_t fd_ {-1};
     std::shared_ptr<AVPacket> cachePacket_ {};
     std::shared_ptr<AVOutputFormat> outputFormat_ {};
     std::shared_ptr<AVFormatContext> formatContext_ {};
     int32_t rotation_ { 0 };
+    int64_t fragmentDurationUs_ { 0 };
+    int64_t expectedDurationUs_ { 0 };
+    int64_t moovSize_ { 0 };
+    int64_t expectedSize_ { 0 };
+    std::unique_ptr<MuxerPreallocator> preallocator_ {};
+    int64_t reservedMoovSize_ { 0 };
+    std::map<int32_t, double> frameRates_ {};
+    std::map<int32_t, int64_t> trackDurations_ {};
+    std::vector<int64_t> trackSamples_ {};
+    int64_t writtenBytes_ { 0 };
+    bool rebaseTime_ { false };
+    int64_t timeOffsetUs_ { 0 };
+    int32_t directWriteThreshold_ { 0 };
+    bool asyncIo_ { false };
+    int32_t writeBehindBuffers_ { 0 };
+    bool directIo_ { false };
+    std::shared_ptr<MuxerWriteBehind> writeBehind_ {}; // read by GetStatistics, use the atomic access
+    int64_t writebackInterval_ { 0 };
+    std::shared_ptr<MuxerWriteback> writeback_ {}; // read by GetStatistics, use the atomic access
 };
 } // Ffmpeg
 } // Plugin
@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "muxer_io_uring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "securec.h"
+#include "avcodec_log.h"
+
+#if defined(__NR_io_uring_setup) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define MUXER_HAS_IO_URING
+#endif
+#endif
+
+namespace {
+    constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "MuxerIoUring"};
+    constexpr size_t BUFFER_ALIGNMENT = 4096;
+}
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Ffmpeg {
+#ifdef MUXER_HAS_IO_URING
+namespace {
+template <typename T>
+T *RingPointer(void *ring, uint32_t offset)
+{
+    return reinterpret_cast<T *>(static_cast<uint8_t *>(ring) + offset);
+}
+
+uint32_t LoadAcquire(const uint32_t *ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+void StoreRelease(uint32_t *ptr, uint32_t value)
+{
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+int32_t IoUringEnter(int32_t ringFd, uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+{
+    return static_cast<int32_t>(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+}
+}
+#endif
+
+std::shared_ptr<MuxerIoUring> MuxerIoUring::Create(int32_t fd, uint32_t bufferCount, uint32_t bufferSize)
+{
+    std::shared_ptr<MuxerIoUring> uring(new (std::nothrow) MuxerIoUring(fd, bufferSize));
+    if (uring == nullptr || !uring->Init(bufferCount)) {
+        return nullptr;
+    }
+    return uring;
+}
+
+MuxerIoUring::MuxerIoUring(int32_t fd, uint32_t bufferSize) : fd_(fd), bufferSize_(bufferSize)
+{
+}
+
+MuxerIoUring::~MuxerIoUring()
+{
+    if (!Drain()) {
+        AVCODEC_LOGE("some writes failed");
+    }
+    Release();
+}
+
+bool MuxerIoUring::Init(uint32_t bufferCount)
+{
+#ifdef MUXER_HAS_IO_URING
+    CHECK_AND_RETURN_RET_LOG(bufferCount > 0 && bufferSize_ > 0, false, "invalid buffer count or size");
+    struct io_uring_params params;
+    (void)memset_s(&params, sizeof(params), 0, sizeof(params));
+    ringFd_ = static_cast<int32_t>(syscall(__NR_io_uring_setup, bufferCount, &params));
+    if (ringFd_ < 0) {
+        AVCODEC_LOGW("io_uring is not available, errno %{public}d", errno);
+        ringFd_ = -1;
+        return false;
+    }
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+        sqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        cqRingSize_ = 0;
+    }
+    if (!MapRings()) {
+        Release();
+        return false;
+    }
+    sqTail_ = RingPointer<uint32_t>(sqRing_, params.sq_off.tail);
+    sqMask_ = RingPointer<uint32_t>(sqRing_, params.sq_off.ring_mask);
+    sqArray_ = RingPointer<uint32_t>(sqRing_, params.sq_off.array);
+    cqHead_ = RingPointer<uint32_t>(cqRing_, params.cq_off.head);
+    cqTail_ = RingPointer<uint32_t>(cqRing_, params.cq_off.tail);
+    cqMask_ = RingPointer<uint32_t>(cqRing_, params.cq_off.ring_mask);
+    cqes_ = RingPointer<void>(cqRing_, params.cq_off.cqes);
+
+    // never more writes in flight than submission entries, so the submission queue can not overflow.
+    bufferCount = std::min(bufferCount, params.sq_entries);
+    void *buffers = nullptr;
+    if (posix_memalign(&buffers, BUFFER_ALIGNMENT, static_cast<size_t>(bufferCount) * bufferSize_) != 0) {
+        AVCODEC_LOGE("alloc io_uring buffers failed");
+        Release();
+        return false;
+    }
+    buffers_ = static_cast<uint8_t *>(buffers);
+    slots_.resize(bufferCount);
+    for (uint32_t i = 0; i < bufferCount; i++) {
+        slots_[i].data = buffers_ + static_cast<size_t>(i) * bufferSize_;
+        slots_[i].iov = {slots_[i].data, bufferSize_};
+    }
+    RegisterBuffers();
+    AVCODEC_LOGI("io_uring writer ready, %{public}u buffers of %{public}u bytes, fixed %{public}d",
+        bufferCount, bufferSize_, fixedBuffers_);
+    return true;
+#else
+    (void)bufferCount;
+    AVCODEC_LOGW("io_uring is not supported by this build");
+    return false;
+#endif
+}
+
+bool MuxerIoUring::MapRings()
+{
+#ifdef MUXER_HAS_IO_URING
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_,
+        IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        sqRing_ = nullptr;
+        AVCODEC_LOGE("map io_uring submission ring failed, errno %{public}d", errno);
+        return false;
+    }
+    if (cqRingSize_ == 0) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_,
+            IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            cqRing_ = nullptr;
+            AVCODEC_LOGE("map io_uring completion ring failed, errno %{public}d", errno);
+            return false;
+        }
+    }
+    sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        sqes_ = nullptr;
+        AVCODEC_LOGE("map io_uring submission entries failed, errno %{public}d", errno);
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MuxerIoUring::RegisterBuffers()
+{
+#ifdef MUXER_HAS_IO_URING
+    std::vector<struct iovec> iovs;
+    for (auto &slot : slots_) {
+        iovs.push_back(slot.iov);
+    }
+    // registering pins the pages, it may exceed RLIMIT_MEMLOCK, then plain writev is used instead.
+    int32_t ret = static_cast<int32_t>(syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_BUFFERS,
+        iovs.data(), static_cast<uint32_t>(iovs.size())));
+    fixedBuffers_ = ret == 0;
+#endif
+}
+
+void MuxerIoUring::Release()
+{
+    if (sqes_ != nullptr) {
+        (void)munmap(sqes_, sqesSize_);
+        sqes_ = nullptr;
+    }
+    if (cqRing_ != nullptr && cqRing_ != sqRing_) {
+        (void)munmap(cqRing_, cqRingSize_);
+    }
+    cqRing_ = nullptr;
+    if (sqRing_ != nullptr) {
+        (void)munmap(sqRing_, sqRingSize_);
+        sqRing_ = nullptr;
+    }
+    if (ringFd_ >= 0) {
+        close(ringFd_);
+        ringFd_ = -1;
+    }
+    free(buffers_);
+    buffers_ = nullptr;
+    slots_.clear();
+}
+
+bool MuxerIoUring::Write(const uint8_t *data, size_t size, int64_t pos)
+{
+    while (size > 0) {
+        if (error_ != 0) {
+            return false;
+        }
+        int32_t index = AcquireSlot();
+        if (index < 0) {
+            return false;
+        }
+        Slot &slot = slots_[index];
+        slot.size = std::min(size, static_cast<size_t>(bufferSize_));
+        slot.pos = pos;
+        errno_t rc = memcpy_s(slot.data, bufferSize_, data, slot.size);
+        CHECK_AND_RETURN_RET_LOG(rc == EOK, false, "memcpy_s failed");
+        Submit(static_cast<uint32_t>(index));
+        data += slot.size;
+        pos += static_cast<int64_t>(slot.size);
+        size -= slot.size;
+    }
+    return error_ == 0;
+}
+
+bool MuxerIoUring::Drain()
+{
+    while (inFlight_ > 0) {
+        if (!WaitCompletion()) {
+            break;
+        }
+    }
+    bool ok = error_ == 0 && inFlight_ == 0;
+    error_ = 0;
+    return ok;
+}
+
+int32_t MuxerIoUring::AcquireSlot()
+{
+    for (;;) {
+        for (size_t i = 0; i < slots_.size(); i++) {
+            if (!slots_[i].busy) {
+                return static_cast<int32_t>(i);
+            }
+        }
+        if (!WaitCompletion()) {
+            return -1;
+        }
+    }
+}
+
+void MuxerIoUring::Submit(uint32_t slotIndex)
+{
+#ifdef MUXER_HAS_IO_URING
+    Slot &slot = slots_[slotIndex];
+    uint32_t tail = *sqTail_;
+    uint32_t index = tail & *sqMask_;
+    auto sqe = static_cast<struct io_uring_sqe *>(sqes_) + index;
+    (void)memset_s(sqe, sizeof(*sqe), 0, sizeof(*sqe));
+    sqe->fd = fd_;
+    sqe->off = static_cast<uint64_t>(slot.pos);
+    sqe->user_data = slotIndex;
+    if (fixedBuffers_) {
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->addr = reinterpret_cast<uint64_t>(slot.data);
+        sqe->len = static_cast<uint32_t>(slot.size);
+        sqe->buf_index = static_cast<uint16_t>(slotIndex);
+    } else {
+        slot.iov.iov_len = slot.size;
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->addr = reinterpret_cast<uint64_t>(&slot.iov);
+        sqe->len = 1;
+    }
+    sqArray_[index] = index;
+    StoreRelease(sqTail_, tail + 1);
+    int32_t ret = 0;
+    do {
+        ret = IoUringEnter(ringFd_, 1, 0, 0);
+    } while (ret < 0 && errno == EINTR);
+    if (ret <= 0) {
+        // the kernel has not taken the entry, take it back so that Drain() never waits for a completion of it,
+        // and write the data here instead.
+        AVCODEC_LOGW("submit io_uring write failed, errno %{public}d, write synchronously", ret < 0 ? errno : 0);
+        StoreRelease(sqTail_, tail);
+        WriteSync(slot, 0);
+        return;
+    }
+    slot.busy = true;
+    inFlight_++;
+#else
+    (void)slotIndex;
+#endif
+}
+
+void MuxerIoUring::WriteSync(const Slot &slot, size_t done)
+{
+    while (done < slot.size) {
+        ssize_t size = pwrite(fd_, slot.data + done, slot.size - done, slot.pos + static_cast<int64_t>(done));
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            error_ = errno != 0 ? errno : EIO;
+            break;
+        }
+        done += static_cast<size_t>(size);
+    }
+}
+
+bool MuxerIoUring::WaitCompletion()
+{
+#ifdef MUXER_HAS_IO_URING
+    if (LoadAcquire(cqTail_) == *cqHead_) {
+        int32_t ret = IoUringEnter(ringFd_, 0, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0 && errno != EINTR) {
+            AVCODEC_LOGE("wait io_uring completion failed, errno %{public}d", errno);
+            error_ = errno;
+            return false;
+        }
+    }
+    ReapCompletions();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MuxerIoUring::ReapCompletions()
+{
+#ifdef MUXER_HAS_IO_URING
+    uint32_t head = *cqHead_;
+    uint32_t tail = LoadAcquire(cqTail_);
+    for (; head != tail; head++) {
+        auto cqe = static_cast<struct io_uring_cqe *>(cqes_) + (head & *cqMask_);
+        if (cqe->user_data >= slots_.size()) {
+            continue;
+        }
+        Slot &slot = slots_[cqe->user_data];
+        if (cqe->res < 0) {
+            AVCODEC_LOGE("io_uring write failed, errno %{public}d", -cqe->res);
+            error_ = -cqe->res;
+        } else if (static_cast<size_t>(cqe->res) < slot.size) {
+            // short writes are rare, the rest is written synchronously.
+            WriteSync(slot, static_cast<size_t>(cqe->res));
+        }
+        slot.busy = false;
+        inFlight_--;
+    }
+    StoreRelease(cqHead_, head);
+#endif
+}
+} // Ffmpeg
+} // Plugin
+} // Media
+} // OHOS
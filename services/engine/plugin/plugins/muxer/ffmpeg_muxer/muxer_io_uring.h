@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MUXER_IO_URING_H
+#define MUXER_IO_URING_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <sys/uio.h>
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Ffmpeg {
+/**
+ * Writes the output through io_uring, so that the caller only waits for the storage when all the
+ * registered buffers are in flight. The data is copied into the buffers, so the caller may reuse its
+ * memory as soon as Write returns. Create returns nullptr when the kernel does not support io_uring.
+ */
+class MuxerIoUring {
+public:
+    static std::shared_ptr<MuxerIoUring> Create(int32_t fd, uint32_t bufferCount, uint32_t bufferSize);
+    ~MuxerIoUring();
+
+    MuxerIoUring(const MuxerIoUring &) = delete;
+    MuxerIoUring &operator=(const MuxerIoUring &) = delete;
+
+    bool Write(const uint8_t *data, size_t size, int64_t pos);
+    // Waits for all the writes in flight, returns false if any of the writes since the last Drain failed.
+    bool Drain();
+    uint32_t GetInFlightCount() const
+    {
+        return inFlight_;
+    }
+
+private:
+    struct Slot {
+        uint8_t *data = nullptr;
+        size_t size = 0;
+        int64_t pos = 0;
+        bool busy = false;
+        struct iovec iov = {};
+    };
+
+    MuxerIoUring(int32_t fd, uint32_t bufferSize);
+    bool Init(uint32_t bufferCount);
+    bool MapRings();
+    void RegisterBuffers();
+    void Submit(uint32_t slotIndex);
+    void WriteSync(const Slot &slot, size_t done);
+    bool WaitCompletion();
+    void ReapCompletions();
+    int32_t AcquireSlot();
+    void Release();
+
+    int32_t fd_ = -1;
+    int32_t ringFd_ = -1;
+    uint32_t bufferSize_ = 0;
+    uint8_t *buffers_ = nullptr;
+    std::vector<Slot> slots_;
+    bool fixedBuffers_ = false;
+    uint32_t inFlight_ = 0;
+    int32_t error_ = 0;
+
+    void *sqRing_ = nullptr;
+    size_t sqRingSize_ = 0;
+    void *cqRing_ = nullptr;
+    size_t cqRingSize_ = 0;
+    void *sqes_ = nullptr;
+    size_t sqesSize_ = 0;
+    uint32_t *sqTail_ = nullptr;
+    uint32_t *sqMask_ = nullptr;
+    uint32_t *sqArray_ = nullptr;
+    uint32_t *cqHead_ = nullptr;
+    uint32_t *cqTail_ = nullptr;
+    uint32_t *cqMask_ = nullptr;
+    void *cqes_ = nullptr;
+};
+} // Ffmpeg
+} // Plugin
+} // Media
+} // OHOS
+#endif // MUXER_IO_URING_H
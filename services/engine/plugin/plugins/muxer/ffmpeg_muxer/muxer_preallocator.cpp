@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "muxer_preallocator.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "avcodec_log.h"
+
+namespace {
+    constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "MuxerPreallocator"};
+}
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Ffmpeg {
+MuxerPreallocator::MuxerPreallocator(int32_t fd, int64_t chunkSize) : fd_(fd), chunkSize_(chunkSize)
+{
+    AVCODEC_LOGI("preallocate in chunks of %{public}" PRId64 " bytes", chunkSize_);
+}
+
+MuxerPreallocator::~MuxerPreallocator()
+{
+    Release();
+}
+
+void MuxerPreallocator::OnWritten(int64_t end)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    writtenEnd_ = std::max(writtenEnd_, end);
+    // allocate the next chunk while half of the current one is still free, so the writes never wait for it.
+    if (failed_ || stop_ || pending_ || writtenEnd_ + chunkSize_ / 2 < allocatedEnd_) {
+        return;
+    }
+    pending_ = true;
+    if (thread_ == nullptr) {
+        thread_ = std::make_unique<std::thread>(&MuxerPreallocator::AllocLoop, this);
+    }
+    cond_.notify_one();
+}
+
+void MuxerPreallocator::Release()
+{
+    std::unique_ptr<std::thread> thread = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        thread = std::move(thread_);
+    }
+    cond_.notify_one();
+    if (thread != nullptr && thread->joinable()) {
+        thread->join();
+    }
+    if (allocatedEnd_ == 0) {
+        return;
+    }
+    // the blocks allocated beyond the size of the file are only released by a truncate.
+    struct stat fileStat;
+    if (fstat(fd_, &fileStat) != 0 || ftruncate(fd_, fileStat.st_size) != 0) {
+        AVCODEC_LOGW("release the preallocated space failed, errno %{public}d", errno);
+    }
+    allocatedEnd_ = 0;
+}
+
+void MuxerPreallocator::AllocLoop()
+{
+    pthread_setname_np(pthread_self(), "muxer_prealloc");
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cond_.wait(lock, [this] { return pending_ || stop_; });
+        if (stop_) {
+            break;
+        }
+        int64_t offset = std::max(allocatedEnd_, writtenEnd_);
+        lock.unlock();
+        int32_t ret = fallocate(fd_, FALLOC_FL_KEEP_SIZE, offset, chunkSize_);
+        int32_t error = errno;
+        lock.lock();
+        pending_ = false;
+        if (ret != 0) {
+            AVCODEC_LOGW("preallocate failed, errno %{public}d, write without preallocation", error);
+            failed_ = true;
+            continue;
+        }
+        allocatedEnd_ = offset + chunkSize_;
+        AVCODEC_LOGD("preallocated to %{public}" PRId64, allocatedEnd_);
+    }
+}
+} // Ffmpeg
+} // Plugin
+} // Media
+} // OHOS
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MUXER_PREALLOCATOR_H
+#define MUXER_PREALLOCATOR_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Ffmpeg {
+/**
+ * Allocates the storage of the output in chunks ahead of the writing on its own thread, so that the mux thread
+ * never waits for the file system to find the blocks. The size of the file is kept, a crash leaves no zeroed tail.
+ */
+class MuxerPreallocator {
+public:
+    MuxerPreallocator(int32_t fd, int64_t chunkSize);
+    ~MuxerPreallocator();
+
+    MuxerPreallocator(const MuxerPreallocator &) = delete;
+    MuxerPreallocator &operator=(const MuxerPreallocator &) = delete;
+
+    // Called on the mux thread with the end of the written data, only asks for the next chunk.
+    void OnWritten(int64_t end);
+    // Waits for the allocation in progress and gives back the blocks beyond the size of the file.
+    void Release();
+
+private:
+    void AllocLoop();
+
+    int32_t fd_ = -1;
+    int64_t chunkSize_ = 0;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::unique_ptr<std::thread> thread_ = nullptr;
+    int64_t writtenEnd_ = 0;
+    int64_t allocatedEnd_ = 0;
+    bool pending_ = false;
+    bool failed_ = false;
+    bool stop_ = false;
+};
+} // Ffmpeg
+} // Plugin
+} // Media
+} // OHOS
+#endif // MUXER_PREALLOCATOR_H
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "muxer_write_behind.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "securec.h"
+#include "avcodec_log.h"
+
+namespace {
+    constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "MuxerWriteBehind"};
+    constexpr size_t DIRECT_IO_ALIGNMENT = 4096;
+
+    int64_t ElapsedUs(std::chrono::steady_clock::time_point begin)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+    }
+}
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Ffmpeg {
+std::shared_ptr<MuxerWriteBehind> MuxerWriteBehind::Create(int32_t fd, uint32_t blockCount, uint32_t blockSize,
+    WrittenCallback onWritten)
+{
+    CHECK_AND_RETURN_RET_LOG(blockCount > 0 && blockSize > 0, nullptr, "invalid block count or size");
+    std::shared_ptr<MuxerWriteBehind> writer(new (std::nothrow) MuxerWriteBehind(fd, blockCount, blockSize,
+        std::move(onWritten)));
+    CHECK_AND_RETURN_RET_LOG(writer != nullptr && writer->buffers_ != nullptr, nullptr, "create write behind failed");
+    writer->thread_ = std::make_unique<std::thread>(&MuxerWriteBehind::IoLoop, writer.get());
+    AVCODEC_LOGI("write behind with %{public}u blocks of %{public}u bytes", blockCount, blockSize);
+    return writer;
+}
+
+MuxerWriteBehind::MuxerWriteBehind(int32_t fd, uint32_t blockCount, uint32_t blockSize,
+    WrittenCallback onWritten)
+    : fd_(fd), blockSize_(blockSize), onWritten_(std::move(onWritten))
+{
+    // the blocks are page aligned, so that they can be written with O_DIRECT.
+    void *buffers = nullptr;
+    if (posix_memalign(&buffers, DIRECT_IO_ALIGNMENT, static_cast<size_t>(blockCount) * blockSize) != 0) {
+        return;
+    }
+    buffers_ = static_cast<uint8_t *>(buffers);
+    blocks_.resize(blockCount);
+    for (uint32_t i = 0; i < blockCount; i++) {
+        blocks_[i].data = buffers_ + static_cast<size_t>(i) * blockSize;
+        freeBlocks_.push_back(i);
+    }
+}
+
+MuxerWriteBehind::~MuxerWriteBehind()
+{
+    if (!Drain()) {
+        AVCODEC_LOGE("some writes failed");
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    if (thread_ != nullptr && thread_->joinable()) {
+        thread_->join();
+    }
+    if (directFd_ >= 0) {
+        close(directFd_);
+    }
+    free(buffers_);
+}
+
+bool MuxerWriteBehind::EnableDirectIo()
+{
+    // the fd of the app can not be switched to O_DIRECT without affecting its other users, so the file is
+    // opened again for the direct writes.
+    CHECK_AND_RETURN_RET_LOG(blockSize_ % DIRECT_IO_ALIGNMENT == 0, false,
+        "block size %{public}u is not aligned for direct io", blockSize_);
+    std::string path = "/proc/self/fd/" + std::to_string(fd_);
+    directFd_ = open(path.c_str(), O_WRONLY | O_DIRECT | O_CLOEXEC);
+    if (directFd_ < 0) {
+        AVCODEC_LOGW("open the output for direct io failed, errno %{public}d", errno);
+        return false;
+    }
+    AVCODEC_LOGI("direct io enabled");
+    return true;
+}
+
+bool MuxerWriteBehind::Write(const uint8_t *data, size_t size, int64_t pos)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (size > 0) {
+        if (error_ != 0) {
+            return false;
+        }
+        if (current_ >= 0) {
+            Block &block = blocks_[current_];
+            // only a write that continues the block is appended, the others start a new one.
+            if (block.pos + static_cast<int64_t>(block.size) != pos || block.size == block.capacity) {
+                SubmitLocked();
+            }
+        }
+        if (current_ < 0 && !AcquireLocked(lock, pos)) {
+            return false;
+        }
+        Block &block = blocks_[current_];
+        size_t length = std::min(size, block.capacity - block.size);
+        errno_t rc = memcpy_s(block.data + block.size, block.capacity - block.size, data, length);
+        CHECK_AND_RETURN_RET_LOG(rc == EOK, false, "memcpy_s failed");
+        block.size += length;
+        data += length;
+        pos += static_cast<int64_t>(length);
+        size -= length;
+    }
+    return true;
+}
+
+bool MuxerWriteBehind::Drain()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (current_ >= 0) {
+        SubmitLocked();
+    }
+    cond_.wait(lock, [this] { return readyBlocks_.empty() && !writing_; });
+    bool ok = error_ == 0;
+    error_ = 0;
+    return ok;
+}
+
+MuxerWriteBehind::Statistics MuxerWriteBehind::GetStatistics() const
+{
+    Statistics stats;
+    stats.writes = writes_.load();
+    stats.bytes = bytes_.load();
+    stats.ioTimeUs = ioTimeUs_.load();
+    stats.maxIoTimeUs = maxIoTimeUs_.load();
+    stats.stallTimeUs = stallTimeUs_.load();
+    stats.directBytes = directBytes_.load();
+    return stats;
+}
+
+void MuxerWriteBehind::SubmitLocked()
+{
+    if (blocks_[current_].size == 0) {
+        freeBlocks_.push_back(static_cast<uint32_t>(current_));
+    } else {
+        readyBlocks_.push_back(static_cast<uint32_t>(current_));
+        cond_.notify_all();
+    }
+    current_ = -1;
+}
+
+bool MuxerWriteBehind::AcquireLocked(std::unique_lock<std::mutex> &lock, int64_t pos)
+{
+    if (freeBlocks_.empty()) {
+        // all the blocks wait for the storage, this is the only place the mux thread is held up by it.
+        auto begin = std::chrono::steady_clock::now();
+        cond_.wait(lock, [this] { return !freeBlocks_.empty() || error_ != 0; });
+        stallTimeUs_ += ElapsedUs(begin);
+        if (error_ != 0) {
+            return false;
+        }
+    }
+    current_ = static_cast<int32_t>(freeBlocks_.front());
+    freeBlocks_.pop_front();
+    Block &block = blocks_[current_];
+    block.size = 0;
+    block.pos = pos;
+    block.capacity = blockSize_;
+    size_t misalignment = static_cast<size_t>(pos) % DIRECT_IO_ALIGNMENT;
+    if (directFd_ >= 0 && misalignment != 0) {
+        // after a patch of the header the output goes on at any position, this block only fills up to the
+        // next aligned position, the following ones are aligned again.
+        block.capacity = DIRECT_IO_ALIGNMENT - misalignment;
+    }
+    return true;
+}
+
+void MuxerWriteBehind::IoLoop()
+{
+    pthread_setname_np(pthread_self(), "muxer_io_loop");
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cond_.wait(lock, [this] { return !readyBlocks_.empty() || stop_; });
+        if (readyBlocks_.empty()) {
+            break;
+        }
+        uint32_t index = readyBlocks_.front();
+        readyBlocks_.pop_front();
+        writing_ = true;
+        lock.unlock();
+        // the blocks are written one by one in submission order, so a later write to the same range wins.
+        int32_t error = WriteBlock(blocks_[index]);
+        if (error == 0 && onWritten_ != nullptr) {
+            onWritten_(blocks_[index].pos, blocks_[index].size);
+        }
+        lock.lock();
+        if (error != 0 && error_ == 0) {
+            error_ = error;
+        }
+        blocks_[index].size = 0;
+        freeBlocks_.push_back(index);
+        writing_ = false;
+        cond_.notify_all();
+    }
+}
+
+int32_t MuxerWriteBehind::WriteBlock(const Block &block)
+{
+    auto begin = std::chrono::steady_clock::now();
+    size_t done = 0;
+    if (directFd_ >= 0 && block.size == blockSize_ && block.pos % static_cast<int64_t>(DIRECT_IO_ALIGNMENT) == 0) {
+        ssize_t size = 0;
+        do {
+            size = pwrite(directFd_, block.data, block.size, block.pos);
+        } while (size < 0 && errno == EINTR);
+        // a short or refused direct write is finished through the page cache.
+        done = size > 0 ? static_cast<size_t>(size) : 0;
+        directBytes_ += static_cast<int64_t>(done);
+    }
+    int32_t error = WriteFully(fd_, block.data + done, block.size - done, block.pos + static_cast<int64_t>(done));
+    if (error != 0) {
+        return error;
+    }
+    int64_t costUs = ElapsedUs(begin);
+    writes_++;
+    bytes_ += static_cast<int64_t>(block.size);
+    ioTimeUs_ += costUs;
+    if (costUs > maxIoTimeUs_) {
+        maxIoTimeUs_ = costUs;
+    }
+    return 0;
+}
+
+int32_t MuxerWriteBehind::WriteFully(int32_t fd, const uint8_t *data, size_t size, int64_t pos)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t ret = pwrite(fd, data + done, size - done, pos + static_cast<int64_t>(done));
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            int32_t error = ret < 0 ? errno : EIO;
+            AVCODEC_LOGE("write file failed, errno %{public}d", error);
+            return error;
+        }
+        done += static_cast<size_t>(ret);
+    }
+    return 0;
+}
+} // Ffmpeg
+} // Plugin
+} // Media
+} // OHOS
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MUXER_WRITE_BEHIND_H
+#define MUXER_WRITE_BEHIND_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Ffmpeg {
+/**
+ * Collects the output into a few blocks that a dedicated io thread writes to the file in order, so that the
+ * mux thread goes on with the next samples while the storage is busy. The mux thread only waits when all the
+ * blocks are filled and not yet written.
+ */
+class MuxerWriteBehind {
+public:
+    struct Statistics {
+        int64_t writes = 0;
+        int64_t bytes = 0;
+        int64_t ioTimeUs = 0;
+        int64_t maxIoTimeUs = 0;
+        int64_t stallTimeUs = 0;
+        int64_t directBytes = 0;
+    };
+
+    // Called on the io thread after each block is written.
+    using WrittenCallback = std::function<void(int64_t pos, size_t size)>;
+
+    static std::shared_ptr<MuxerWriteBehind> Create(int32_t fd, uint32_t blockCount, uint32_t blockSize,
+        WrittenCallback onWritten = nullptr);
+    ~MuxerWriteBehind();
+
+    MuxerWriteBehind(const MuxerWriteBehind &) = delete;
+    MuxerWriteBehind &operator=(const MuxerWriteBehind &) = delete;
+
+    bool Write(const uint8_t *data, size_t size, int64_t pos);
+    // Waits until all the blocks are written, returns false if any of the writes since the last Drain failed.
+    bool Drain();
+    /**
+     * Writes the full blocks at aligned positions with O_DIRECT, bypassing the page cache. The rest, such as
+     * the header patches and the tail, still goes through the page cache. Called before the first Write.
+     */
+    bool EnableDirectIo();
+    Statistics GetStatistics() const;
+
+private:
+    struct Block {
+        uint8_t *data = nullptr;
+        size_t capacity = 0; // less than the block size to bring the next block to an aligned position
+        size_t size = 0;
+        int64_t pos = 0;
+    };
+
+    MuxerWriteBehind(int32_t fd, uint32_t blockCount, uint32_t blockSize, WrittenCallback onWritten);
+    void SubmitLocked();
+    bool AcquireLocked(std::unique_lock<std::mutex> &lock, int64_t pos);
+    void IoLoop();
+    int32_t WriteBlock(const Block &block);
+    static int32_t WriteFully(int32_t fd, const uint8_t *data, size_t size, int64_t pos);
+
+    int32_t fd_ = -1;
+    int32_t directFd_ = -1;
+    uint32_t blockSize_ = 0;
+    WrittenCallback onWritten_ = nullptr;
+    uint8_t *buffers_ = nullptr;
+    std::vector<Block> blocks_;
+    std::deque<uint32_t> freeBlocks_;
+    std::deque<uint32_t> readyBlocks_;
+    int32_t current_ = -1;
+    bool writing_ = false;
+    bool stop_ = false;
+    int32_t error_ = 0;
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    std::unique_ptr<std::thread> thread_ = nullptr;
+
+    std::atomic<int64_t> writes_ = 0;
+    std::atomic<int64_t> bytes_ = 0;
+    std::atomic<int64_t> ioTimeUs_ = 0;
+    std::atomic<int64_t> maxIoTimeUs_ = 0;
+    std::atomic<int64_t> stallTimeUs_ = 0;
+    std::atomic<int64_t> directBytes_ = 0;
+};
+} // Ffmpeg
+} // Plugin
+} // Media
+} // OHOS
+#endif // MUXER_WRITE_BEHIND_H
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "muxer_writeback.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "avcodec_log.h"
+
+namespace {
+    constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "MuxerWriteback"};
+}
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Ffmpeg {
+MuxerWriteback::MuxerWriteback(int32_t fd, int64_t intervalBytes) : fd_(fd), intervalBytes_(intervalBytes)
+{
+    AVCODEC_LOGI("writeback every %{public}" PRId64 " bytes", intervalBytes_);
+}
+
+MuxerWriteback::~MuxerWriteback()
+{
+    std::unique_ptr<std::thread> thread = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        thread = std::move(thread_);
+    }
+    cond_.notify_one();
+    if (thread != nullptr && thread->joinable()) {
+        thread->join();
+    }
+}
+
+void MuxerWriteback::OnWritten(int64_t pos, size_t size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t end = pos + static_cast<int64_t>(size);
+    // the output is mostly sequential, the few writes back into the header are simply folded into the range.
+    if (dirtyStart_ < 0) {
+        dirtyStart_ = pos;
+        dirtyEnd_ = end;
+    } else {
+        dirtyStart_ = std::min(dirtyStart_, pos);
+        dirtyEnd_ = std::max(dirtyEnd_, end);
+    }
+    dirtyBytes_ = dirtyEnd_ - dirtyStart_;
+    if (dirtyEnd_ - dirtyStart_ >= intervalBytes_) {
+        HandOverLocked();
+    }
+}
+
+void MuxerWriteback::Flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (dirtyStart_ >= 0) {
+        HandOverLocked();
+    }
+}
+
+MuxerWriteback::Statistics MuxerWriteback::GetStatistics() const
+{
+    Statistics stats;
+    stats.intervalBytes = intervalBytes_;
+    stats.dirtyBytes = dirtyBytes_.load();
+    stats.inFlightBytes = inFlightBytes_.load();
+    stats.syncedBytes = syncedBytes_.load();
+    stats.waitTimeUs = waitTimeUs_.load();
+    return stats;
+}
+
+void MuxerWriteback::HandOverLocked()
+{
+    // a range the thread has not picked up yet is merged, the thread only falls behind when the storage does.
+    if (pendingStart_ < 0) {
+        pendingStart_ = dirtyStart_;
+        pendingEnd_ = dirtyEnd_;
+    } else {
+        pendingStart_ = std::min(pendingStart_, dirtyStart_);
+        pendingEnd_ = std::max(pendingEnd_, dirtyEnd_);
+    }
+    dirtyStart_ = -1;
+    dirtyEnd_ = -1;
+    dirtyBytes_ = 0;
+    if (thread_ == nullptr && !stop_) {
+        thread_ = std::make_unique<std::thread>(&MuxerWriteback::WritebackLoop, this);
+    }
+    cond_.notify_one();
+}
+
+void MuxerWriteback::WritebackLoop()
+{
+    pthread_setname_np(pthread_self(), "muxer_writeback");
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cond_.wait(lock, [this] { return pendingStart_ >= 0 || stop_; });
+        if (pendingStart_ < 0) {
+            break;
+        }
+        int64_t start = pendingStart_;
+        int64_t end = pendingEnd_;
+        bool stopping = stop_;
+        pendingStart_ = -1;
+        pendingEnd_ = -1;
+        lock.unlock();
+        (void)SyncRange(start, end, SYNC_FILE_RANGE_WRITE);
+        // then wait for the previous interval, so that at most two intervals are under writeback at a time. a
+        // last range handed over when stopping is only started, the app decides whether to wait with fsync.
+        if (inFlightStart_ >= 0 && !stopping) {
+            auto begin = std::chrono::steady_clock::now();
+            (void)SyncRange(inFlightStart_, inFlightEnd_,
+                SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            waitTimeUs_ += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - begin).count();
+            syncedBytes_ += inFlightEnd_ - inFlightStart_;
+        }
+        inFlightStart_ = start;
+        inFlightEnd_ = end;
+        inFlightBytes_ = end - start;
+        lock.lock();
+    }
+}
+
+bool MuxerWriteback::SyncRange(int64_t start, int64_t end, uint32_t flags)
+{
+    if (useRangeSync_) {
+        if (sync_file_range(fd_, start, end - start, flags) == 0) {
+            return true;
+        }
+        if (errno != ENOSYS && errno != EINVAL) {
+            AVCODEC_LOGW("sync file range failed, errno %{public}d", errno);
+            return false;
+        }
+        AVCODEC_LOGW("sync file range is not supported, errno %{public}d, use fdatasync instead", errno);
+        useRangeSync_ = false;
+    }
+    // fdatasync can not be started without waiting, only the waiting step writes the file back then.
+    if ((flags & SYNC_FILE_RANGE_WAIT_AFTER) == 0) {
+        return true;
+    }
+    if (fdatasync(fd_) != 0) {
+        AVCODEC_LOGW("fdatasync failed, errno %{public}d", errno);
+        return false;
+    }
+    return true;
+}
+} // Ffmpeg
+} // Plugin
+} // Media
+} // OHOS
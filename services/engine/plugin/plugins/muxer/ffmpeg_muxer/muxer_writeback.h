@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MUXER_WRITEBACK_H
+#define MUXER_WRITEBACK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Ffmpeg {
+/**
+ * Starts the writeback of the output every interval bytes and waits for the interval before it on its own
+ * thread, so the dirty page cache of a recording stays within about two intervals and Stop() or a later fsync
+ * has little to flush, while the writing thread never waits for the storage.
+ */
+class MuxerWriteback {
+public:
+    struct Statistics {
+        int64_t intervalBytes = 0;
+        int64_t dirtyBytes = 0;
+        int64_t inFlightBytes = 0;
+        int64_t syncedBytes = 0;
+        int64_t waitTimeUs = 0;
+    };
+
+    MuxerWriteback(int32_t fd, int64_t intervalBytes);
+    ~MuxerWriteback();
+
+    MuxerWriteback(const MuxerWriteback &) = delete;
+    MuxerWriteback &operator=(const MuxerWriteback &) = delete;
+
+    // Called once the bytes are handed to the file, may be called from the io thread, never waits for the storage.
+    void OnWritten(int64_t pos, size_t size);
+    // Starts the writeback of all the dirty bytes without waiting for it.
+    void Flush();
+    Statistics GetStatistics() const;
+
+private:
+    void HandOverLocked();
+    void WritebackLoop();
+    bool SyncRange(int64_t start, int64_t end, uint32_t flags);
+
+    int32_t fd_ = -1;
+    int64_t intervalBytes_ = 0;
+    bool useRangeSync_ = true; // only used on the writeback thread
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::unique_ptr<std::thread> thread_ = nullptr;
+    bool stop_ = false;
+    int64_t dirtyStart_ = -1;
+    int64_t dirtyEnd_ = -1;
+    int64_t pendingStart_ = -1; // handed over, not started yet
+    int64_t pendingEnd_ = -1;
+    int64_t inFlightStart_ = -1; // only used on the writeback thread
+    int64_t inFlightEnd_ = -1;
+
+    std::atomic<int64_t> dirtyBytes_ = 0;
+    std::atomic<int64_t> inFlightBytes_ = 0;
+    std::atomic<int64_t> syncedBytes_ = 0;
+    std::atomic<int64_t> waitTimeUs_ = 0;
+};
+} // Ffmpeg
+} // Plugin
+} // Media
+} // OHOS
+#endif // MUXER_WRITEBACK_H
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mp4_box_writer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <unistd.h>
+#include "avcodec_log.h"
+
+namespace {
+    constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "Mp4BoxWriter"};
+    constexpr uint32_t BOX_HEADER_SIZE = 8;
+    constexpr size_t ZERO_CHUNK_SIZE = 4096;
+}
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Mp4 {
+Mp4BoxWriter::Mp4BoxWriter(int32_t fd, uint64_t pos, size_t bufferSize)
+    : fd_(fd), pos_(pos), bufferSize_(bufferSize)
+{
+    buffer_.reserve(bufferSize_);
+}
+
+uint64_t Mp4BoxWriter::Begin(uint32_t type)
+{
+    uint64_t boxPos = GetPosition();
+    Put32(0); // patched by End()
+    Put32(type);
+    return boxPos;
+}
+
+uint64_t Mp4BoxWriter::BeginFull(uint32_t type, uint8_t version, uint32_t flags)
+{
+    uint64_t boxPos = Begin(type);
+    Put8(version);
+    Put24(flags);
+    return boxPos;
+}
+
+void Mp4BoxWriter::End(uint64_t boxPos)
+{
+    uint64_t size = GetPosition() - boxPos;
+    if (size > UINT32_MAX || size < BOX_HEADER_SIZE) {
+        AVCODEC_LOGE("box size %{public}" PRIu64 " is invalid", size);
+        error_ = true;
+        return;
+    }
+    Patch32(boxPos, static_cast<uint32_t>(size));
+}
+
+void Mp4BoxWriter::Patch32(uint64_t pos, uint32_t value)
+{
+    uint8_t bytes[] = {
+        static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16), // 24, 16
+        static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value), // 8
+    };
+    if (pos >= pos_) {
+        size_t offset = static_cast<size_t>(pos - pos_);
+        for (size_t i = 0; i < sizeof(bytes); i++) {
+            buffer_[offset + i] = bytes[i];
+        }
+        return;
+    }
+    // the field has been written out already, at least in part, it is patched in the file.
+    (void)Flush();
+    if (!WriteAt(bytes, sizeof(bytes), pos)) {
+        error_ = true;
+    }
+}
+
+void Mp4BoxWriter::Put8(uint8_t value)
+{
+    if (buffer_.size() >= bufferSize_) {
+        (void)Flush();
+    }
+    buffer_.push_back(value);
+}
+
+void Mp4BoxWriter::Put16(uint16_t value)
+{
+    Put8(static_cast<uint8_t>(value >> 8)); // 8
+    Put8(static_cast<uint8_t>(value));
+}
+
+void Mp4BoxWriter::Put24(uint32_t value)
+{
+    Put8(static_cast<uint8_t>(value >> 16)); // 16
+    Put16(static_cast<uint16_t>(value));
+}
+
+void Mp4BoxWriter::Put32(uint32_t value)
+{
+    Put16(static_cast<uint16_t>(value >> 16)); // 16
+    Put16(static_cast<uint16_t>(value));
+}
+
+void Mp4BoxWriter::Put64(uint64_t value)
+{
+    Put32(static_cast<uint32_t>(value >> 32)); // 32
+    Put32(static_cast<uint32_t>(value));
+}
+
+void Mp4BoxWriter::PutZeros(size_t size)
+{
+    static const uint8_t zeros[ZERO_CHUNK_SIZE] = {};
+    while (size > 0) {
+        size_t chunk = std::min(size, sizeof(zeros));
+        PutBytes(zeros, chunk);
+        size -= chunk;
+    }
+}
+
+void Mp4BoxWriter::PutBytes(const uint8_t *data, size_t size)
+{
+    if (buffer_.size() + size > bufferSize_) {
+        (void)Flush();
+    }
+    if (size >= bufferSize_) {
+        // a large payload, such as a cover image, is written as it is.
+        if (!WriteAt(data, size, pos_)) {
+            error_ = true;
+        }
+        pos_ += size;
+        return;
+    }
+    buffer_.insert(buffer_.end(), data, data + size);
+}
+
+bool Mp4BoxWriter::Flush()
+{
+    if (!buffer_.empty()) {
+        if (!WriteAt(buffer_.data(), buffer_.size(), pos_)) {
+            error_ = true;
+        }
+        pos_ += buffer_.size();
+        buffer_.clear();
+    }
+    return !error_;
+}
+
+bool Mp4BoxWriter::WriteAt(const uint8_t *data, size_t size, uint64_t pos)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t ret = pwrite(fd_, data + done, size - done, static_cast<off_t>(pos + done));
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        CHECK_AND_RETURN_RET_LOG(ret > 0, false, "write box failed, errno %{public}d", errno);
+        done += static_cast<size_t>(ret);
+    }
+    return true;
+}
+} // Mp4
+} // Plugin
+} // Media
+} // OHOS
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MP4_BOX_WRITER_H
+#define MP4_BOX_WRITER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Mp4 {
+constexpr uint32_t Fourcc(const char (&type)[5])
+{
+    return (static_cast<uint32_t>(static_cast<uint8_t>(type[0])) << 24) | // 24
+        (static_cast<uint32_t>(static_cast<uint8_t>(type[1])) << 16) | // 16
+        (static_cast<uint32_t>(static_cast<uint8_t>(type[2])) << 8) | // 8
+        static_cast<uint32_t>(static_cast<uint8_t>(type[3])); // 3
+}
+
+/**
+ * The layout of a box whose content is known at compile time, the whole box with its header is built as a
+ * constant and written with a single copy.
+ */
+template <size_t PAYLOAD>
+struct BoxLayout {
+    static constexpr size_t HEADER_SIZE = 8;
+    static constexpr size_t SIZE = HEADER_SIZE + PAYLOAD;
+    std::array<uint8_t, SIZE> bytes {};
+
+    constexpr BoxLayout(uint32_t type, const std::array<uint8_t, PAYLOAD> &payload)
+    {
+        Put32(0, static_cast<uint32_t>(SIZE));
+        Put32(4, type); // 4
+        for (size_t i = 0; i < PAYLOAD; i++) {
+            bytes[HEADER_SIZE + i] = payload[i];
+        }
+    }
+
+private:
+    constexpr void Put32(size_t pos, uint32_t value)
+    {
+        bytes[pos] = static_cast<uint8_t>(value >> 24); // 24
+        bytes[pos + 1] = static_cast<uint8_t>(value >> 16); // 16
+        bytes[pos + 2] = static_cast<uint8_t>(value >> 8); // 2, 8
+        bytes[pos + 3] = static_cast<uint8_t>(value); // 3
+    }
+};
+
+/**
+ * Serializes boxes into a buffer that is written to the file at a given position whenever it fills up. The
+ * size of a box is patched by End(), in the buffer while the header is still there, in the file otherwise,
+ * so a moov of any size is written without holding it all in memory.
+ */
+class Mp4BoxWriter {
+public:
+    Mp4BoxWriter(int32_t fd, uint64_t pos, size_t bufferSize = DEFAULT_BUFFER_SIZE);
+    ~Mp4BoxWriter() = default;
+
+    Mp4BoxWriter(const Mp4BoxWriter &) = delete;
+    Mp4BoxWriter &operator=(const Mp4BoxWriter &) = delete;
+
+    // Starts a box and returns its position for End().
+    uint64_t Begin(uint32_t type);
+    uint64_t BeginFull(uint32_t type, uint8_t version, uint32_t flags);
+    void End(uint64_t boxPos);
+    // Overwrites a 32-bit field written before, such as an entry count only known after the entries.
+    void Patch32(uint64_t pos, uint32_t value);
+    template <size_t PAYLOAD>
+    void Put(const BoxLayout<PAYLOAD> &layout)
+    {
+        PutBytes(layout.bytes.data(), layout.bytes.size());
+    }
+    void Put8(uint8_t value);
+    void Put16(uint16_t value);
+    void Put24(uint32_t value);
+    void Put32(uint32_t value);
+    void Put64(uint64_t value);
+    void PutZeros(size_t size);
+    void PutBytes(const uint8_t *data, size_t size);
+    // Writes out what is buffered, returns false if any write of the writer failed.
+    bool Flush();
+    uint64_t GetPosition() const
+    {
+        return pos_ + buffer_.size();
+    }
+
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+private:
+    bool WriteAt(const uint8_t *data, size_t size, uint64_t pos);
+
+    int32_t fd_ = -1;
+    uint64_t pos_ = 0; // the file position of the first buffered byte
+    size_t bufferSize_ = DEFAULT_BUFFER_SIZE;
+    std::vector<uint8_t> buffer_;
+    bool error_ = false;
+};
+} // Mp4
+} // Plugin
+} // Media
+} // OHOS
+#endif // MP4_BOX_WRITER_H
@@ -0,0 +1,1345 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mp4_muxer_plugin.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <string_view>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include "avcodec_common.h"
+#include "avcodec_info.h"
+#include "avcodec_log.h"
+
+namespace {
+    constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "Mp4MuxerPlugin"};
+    constexpr int64_t USEC_PER_SEC = 1000000;
+    constexpr uint32_t MOVIE_TIMESCALE = 1000;
+    constexpr uint32_t VIDEO_TIMESCALE = 90000;
+    constexpr uint64_t MAC_EPOCH_OFFSET = 2082844800; // seconds from 1904 to 1970
+    constexpr uint32_t BOX_HEADER_SIZE = 8;
+    constexpr uint32_t FIXED_ONE = 0x00010000; // 1.0 in 16.16
+    constexpr uint16_t VOLUME_ONE = 0x0100; // 1.0 in 8.8
+    constexpr uint32_t RESOLUTION_72_DPI = 0x00480000;
+    constexpr uint16_t LANGUAGE_UND = 0x55C4;
+    constexpr uint16_t LANGUAGE_LOCATION = 0x15C7;
+    constexpr uint32_t NAL_LENGTH_SIZE = 4;
+    constexpr uint8_t AVC_NAL_TYPE_MASK = 0x1F;
+    constexpr uint8_t AVC_NAL_SPS = 7;
+    constexpr uint8_t AVC_NAL_PPS = 8;
+    constexpr uint32_t AVC_PROFILE_SIZE = 3; // profile, compatibility and level after the nal header
+    constexpr uint32_t ADTS_HEADER_SIZE = 7;
+    constexpr uint32_t ADTS_CRC_SIZE = 2;
+    constexpr int64_t AAC_FRAME_SAMPLES = 1024;
+    constexpr int64_t MP3_FRAME_SAMPLES = 1152;
+    constexpr double DEFAULT_FRAME_RATE = 30.0;
+    constexpr uint8_t OBJECT_TYPE_MPEG4_VIDEO = 0x20;
+    constexpr uint8_t OBJECT_TYPE_AAC = 0x40;
+    constexpr uint8_t OBJECT_TYPE_MP3 = 0x6B;
+    constexpr uint8_t STREAM_TYPE_VIDEO = 0x11;
+    constexpr uint8_t STREAM_TYPE_AUDIO = 0x15;
+    constexpr uint8_t AAC_OBJECT_LC = 2;
+    constexpr uint32_t COVER_TYPE_JPEG = 13;
+    constexpr uint32_t COVER_TYPE_PNG = 14;
+    constexpr uint32_t COVER_TYPE_BMP = 27;
+    constexpr size_t MAX_WRITE_IOV = 1024;
+    // the upper bound of the moov, as if the sample tables had no runs at all.
+    constexpr uint64_t MOOV_MOVIE_OVERHEAD = 1024;
+    constexpr uint64_t MOOV_TRACK_OVERHEAD = 1024;
+    constexpr uint64_t STTS_ENTRY_SIZE = 8;
+    constexpr uint64_t CTTS_ENTRY_SIZE = 8;
+    constexpr uint64_t STSS_ENTRY_SIZE = 4;
+    constexpr uint64_t STSC_ENTRY_SIZE = 12;
+    constexpr uint64_t STSZ_ENTRY_SIZE = 4;
+    constexpr uint64_t STCO_ENTRY_SIZE = 4;
+    constexpr uint64_t CO64_ENTRY_SIZE = 8;
+    constexpr uint64_t MOOV_MARGIN_DIVISOR = 4; // reserve another 25% for the expected durations
+    constexpr int64_t OTHER_SAMPLES_PER_SEC = 50;
+    constexpr size_t MOVE_BUFFER_SIZE = 1024 * 1024;
+    constexpr int32_t AAC_SAMPLE_RATES[] = {
+        96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+    };
+}
+
+namespace {
+using namespace OHOS::Media;
+using namespace Plugin;
+using namespace Mp4;
+
+template <size_t N>
+constexpr void Store32(std::array<uint8_t, N> &bytes, size_t pos, uint32_t value)
+{
+    bytes[pos] = static_cast<uint8_t>(value >> 24); // 24
+    bytes[pos + 1] = static_cast<uint8_t>(value >> 16); // 16
+    bytes[pos + 2] = static_cast<uint8_t>(value >> 8); // 2, 8
+    bytes[pos + 3] = static_cast<uint8_t>(value); // 3
+}
+
+template <size_t N>
+constexpr BoxLayout<8 + 4 * N> MakeFtyp(uint32_t major, const uint32_t (&compatible)[N])
+{
+    constexpr uint32_t minorVersion = 0x200;
+    std::array<uint8_t, 8 + 4 * N> payload {}; // 8, 4
+    Store32(payload, 0, major);
+    Store32(payload, 4, minorVersion); // 4
+    for (size_t i = 0; i < N; i++) {
+        Store32(payload, 8 + 4 * i, compatible[i]); // 8, 4
+    }
+    return BoxLayout<8 + 4 * N>(Fourcc("ftyp"), payload); // 8, 4
+}
+
+template <size_t N>
+constexpr BoxLayout<24 + N> MakeHdlr(uint32_t handler, const char (&name)[N])
+{
+    // version and flags, pre_defined, handler_type, reserved[3] and the name with its terminator.
+    std::array<uint8_t, 24 + N> payload {}; // 24
+    Store32(payload, 8, handler); // 8
+    for (size_t i = 0; i < N; i++) {
+        payload[24 + i] = static_cast<uint8_t>(name[i]); // 24
+    }
+    return BoxLayout<24 + N>(Fourcc("hdlr"), payload); // 24
+}
+
+bool MoveData(int32_t fd, uint64_t begin, uint64_t end, uint64_t shift)
+{
+    // from the end backwards, so the data not moved yet is never overwritten.
+    std::vector<uint8_t> buffer(static_cast<size_t>(std::min<uint64_t>(MOVE_BUFFER_SIZE, end - begin)));
+    while (end > begin) {
+        size_t size = static_cast<size_t>(std::min<uint64_t>(buffer.size(), end - begin));
+        uint64_t from = end - size;
+        for (size_t done = 0; done < size;) {
+            ssize_t ret = pread(fd, buffer.data() + done, size - done, static_cast<off_t>(from + done));
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+            CHECK_AND_RETURN_RET_LOG(ret > 0, false, "read the media data failed, errno %{public}d", errno);
+            done += static_cast<size_t>(ret);
+        }
+        for (size_t done = 0; done < size;) {
+            ssize_t ret = pwrite(fd, buffer.data() + done, size - done, static_cast<off_t>(from + shift + done));
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+            CHECK_AND_RETURN_RET_LOG(ret > 0, false, "move the media data failed, errno %{public}d", errno);
+            done += static_cast<size_t>(ret);
+        }
+        end = from;
+    }
+    return true;
+}
+
+bool HasNonZeroValue(const MediaDescription &param, std::string_view key)
+{
+    int32_t intValue = 0;
+    int64_t longValue = 0;
+    switch (param.GetValueType(key)) {
+        case FORMAT_TYPE_INT32:
+            return param.GetIntValue(key, intValue) && intValue != 0;
+        case FORMAT_TYPE_INT64:
+            return param.GetLongValue(key, longValue) && longValue != 0;
+        default:
+            return param.ContainKey(key);
+    }
+}
+
+constexpr uint32_t MP4_BRANDS[] = {Fourcc("isom"), Fourcc("iso2"), Fourcc("avc1"), Fourcc("mp41")};
+constexpr uint32_t M4A_BRANDS[] = {Fourcc("M4A "), Fourcc("mp42"), Fourcc("isom")};
+constexpr auto MP4_FTYP = MakeFtyp(Fourcc("isom"), MP4_BRANDS);
+constexpr auto M4A_FTYP = MakeFtyp(Fourcc("M4A "), M4A_BRANDS);
+constexpr auto VIDEO_HDLR = MakeHdlr(Fourcc("vide"), "VideoHandler");
+constexpr auto SOUND_HDLR = MakeHdlr(Fourcc("soun"), "SoundHandler");
+constexpr auto METADATA_HDLR = MakeHdlr(Fourcc("mdir"), "");
+// a dref with one self contained url entry.
+constexpr BoxLayout<28> DINF_BOX(Fourcc("dinf"), {
+    0, 0, 0, 28, 'd', 'r', 'e', 'f', 0, 0, 0, 0, 0, 0, 0, 1,
+    0, 0, 0, 12, 'u', 'r', 'l', ' ', 0, 0, 0, 1,
+});
+constexpr BoxLayout<12> VMHD_BOX(Fourcc("vmhd"), {0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0});
+constexpr BoxLayout<8> SMHD_BOX(Fourcc("smhd"), {0, 0, 0, 0, 0, 0, 0, 0});
+
+using Matrix = std::array<int32_t, 9>;
+constexpr int32_t MATRIX_W = 0x40000000; // 1.0 in 2.30
+constexpr Matrix IDENTITY_MATRIX = {0x10000, 0, 0, 0, 0x10000, 0, 0, 0, MATRIX_W};
+constexpr Matrix ROTATION_90_MATRIX = {0, 0x10000, 0, -0x10000, 0, 0, 0, 0, MATRIX_W};
+constexpr Matrix ROTATION_180_MATRIX = {-0x10000, 0, 0, 0, -0x10000, 0, 0, 0, MATRIX_W};
+constexpr Matrix ROTATION_270_MATRIX = {0, -0x10000, 0, 0x10000, 0, 0, 0, 0, MATRIX_W};
+
+struct CodecInfo {
+    Mp4MuxerPlugin::TrackKind kind;
+    uint32_t sampleEntry;
+    uint8_t objectType;
+    uint32_t coverType;
+};
+
+using TrackKind = Mp4MuxerPlugin::TrackKind;
+const std::unordered_map<std::string_view, CodecInfo> g_mp4Codecs = {
+    {CodecMimeType::VIDEO_AVC, {TrackKind::VIDEO, Fourcc("avc1"), 0, 0}},
+    {CodecMimeType::VIDEO_MPEG4, {TrackKind::VIDEO, Fourcc("mp4v"), OBJECT_TYPE_MPEG4_VIDEO, 0}},
+    {CodecMimeType::AUDIO_AAC, {TrackKind::AUDIO, Fourcc("mp4a"), OBJECT_TYPE_AAC, 0}},
+    {CodecMimeType::AUDIO_MPEG, {TrackKind::AUDIO, Fourcc("mp4a"), OBJECT_TYPE_MP3, 0}},
+    {CodecMimeType::IMAGE_JPG, {TrackKind::IMAGE, 0, 0, COVER_TYPE_JPEG}},
+    {CodecMimeType::IMAGE_PNG, {TrackKind::IMAGE, 0, 0, COVER_TYPE_PNG}},
+    {CodecMimeType::IMAGE_BMP, {TrackKind::IMAGE, 0, 0, COVER_TYPE_BMP}},
+};
+
+const std::string MP4_PLUGIN_NAME = "mp4Mux_mp4";
+const std::string M4A_PLUGIN_NAME = "mp4Mux_m4a";
+
+int32_t Sniff(const std::string& pluginName, uint32_t outputFormat)
+{
+    // above the 60 of the ffmpeg muxer, which is still there for what this plugin does not write.
+    constexpr int32_t mp4Confidence = 80;
+    if ((pluginName == MP4_PLUGIN_NAME && outputFormat == OUTPUT_FORMAT_MPEG_4) ||
+        (pluginName == M4A_PLUGIN_NAME && outputFormat == OUTPUT_FORMAT_M4A)) {
+        return mp4Confidence;
+    }
+    return 0;
+}
+
+Status RegisterMuxerPlugins(const std::shared_ptr<Register>& reg)
+{
+    for (auto &pluginName : {MP4_PLUGIN_NAME, M4A_PLUGIN_NAME}) {
+        MuxerPluginDef def;
+        def.name = pluginName;
+        def.description = "native mp4 muxer";
+        def.rank = 100; // 100
+        def.creator = [](const std::string& name, int32_t fd) -> std::shared_ptr<MuxerPlugin> {
+            CHECK_AND_RETURN_RET_LOG(fd >= 0, nullptr, "fd %{public}d is invalid!", fd);
+            return std::make_shared<Mp4MuxerPlugin>(name, fd, name == M4A_PLUGIN_NAME);
+        };
+        def.sniffer = Sniff;
+        if (reg->AddPlugin(def) != Status::NO_ERROR) {
+            AVCODEC_LOGW("register plugin %{public}s failed", pluginName.c_str());
+        }
+    }
+    return Status::NO_ERROR;
+}
+
+PLUGIN_DEFINITION(Mp4Muxer, LicenseType::APACHE_V2, RegisterMuxerPlugins, [] {})
+
+int64_t RescaleTime(int64_t timeUs, uint32_t timescale)
+{
+    // split to keep the product in range for recordings of any length, rounded to the nearest unit.
+    int64_t seconds = timeUs / USEC_PER_SEC;
+    int64_t remainder = timeUs % USEC_PER_SEC;
+    if (remainder < 0) {
+        remainder += USEC_PER_SEC;
+        seconds--;
+    }
+    return seconds * timescale + (remainder * timescale + USEC_PER_SEC / 2) / USEC_PER_SEC; // 2
+}
+
+uint32_t GetStartCodeSize(const uint8_t *data, uint32_t size, uint32_t pos)
+{
+    if (pos + 3 <= size && data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1) { // 3, 2
+        return 3; // 3
+    }
+    if (pos + 4 <= size && data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 0 && // 4, 2
+        data[pos + 3] == 1) { // 3
+        return 4; // 4
+    }
+    return 0;
+}
+
+// Splits an annex-b stream into its nal units, the start codes are left out.
+void SplitNalUnits(const uint8_t *data, uint32_t size, std::vector<std::pair<uint32_t, uint32_t>> &nalUnits)
+{
+    nalUnits.clear();
+    uint32_t pos = 0;
+    uint32_t start = 0;
+    bool inNal = false;
+    while (pos < size) {
+        uint32_t startCode = (data[pos] == 0) ? GetStartCodeSize(data, size, pos) : 0;
+        if (startCode == 0) {
+            pos++;
+            continue;
+        }
+        if (inNal && pos > start) {
+            nalUnits.emplace_back(start, pos - start);
+        }
+        pos += startCode;
+        start = pos;
+        inNal = true;
+    }
+    if (inNal && size > start) {
+        nalUnits.emplace_back(start, size - start);
+    }
+}
+
+bool IsAnnexB(const uint8_t *data, uint32_t size)
+{
+    return GetStartCodeSize(data, size, 0) > 0;
+}
+
+std::vector<uint8_t> BuildAvcC(const uint8_t *data, uint32_t size)
+{
+    std::vector<std::pair<uint32_t, uint32_t>> nalUnits;
+    SplitNalUnits(data, size, nalUnits);
+    std::vector<std::pair<uint32_t, uint32_t>> sps;
+    std::vector<std::pair<uint32_t, uint32_t>> pps;
+    for (auto &nal : nalUnits) {
+        uint8_t type = data[nal.first] & AVC_NAL_TYPE_MASK;
+        if (type == AVC_NAL_SPS && nal.second > AVC_PROFILE_SIZE && nal.second <= UINT16_MAX) {
+            sps.push_back(nal);
+        } else if (type == AVC_NAL_PPS && nal.second <= UINT16_MAX) {
+            pps.push_back(nal);
+        }
+    }
+    std::vector<uint8_t> avcC;
+    CHECK_AND_RETURN_RET_LOG(!sps.empty() && !pps.empty(), avcC, "no sps or pps in the avc config");
+    constexpr uint8_t lengthSizeMinusOne = 0xFF; // 4 bytes nal length, with the reserved bits
+    constexpr uint8_t spsCountReserved = 0xE0;
+    constexpr uint8_t maxCount = 0x1F;
+    const uint8_t *profile = data + sps[0].first + 1;
+    avcC = {1, profile[0], profile[1], profile[2], lengthSizeMinusOne}; // 2
+    avcC.push_back(spsCountReserved | static_cast<uint8_t>(std::min<size_t>(sps.size(), maxCount)));
+    auto append = [&avcC, data](const std::pair<uint32_t, uint32_t> &nal) {
+        avcC.push_back(static_cast<uint8_t>(nal.second >> 8)); // 8
+        avcC.push_back(static_cast<uint8_t>(nal.second));
+        avcC.insert(avcC.end(), data + nal.first, data + nal.first + nal.second);
+    };
+    for (size_t i = 0; i < sps.size() && i < maxCount; i++) {
+        append(sps[i]);
+    }
+    avcC.push_back(static_cast<uint8_t>(std::min<size_t>(pps.size(), UINT8_MAX)));
+    for (size_t i = 0; i < pps.size() && i < UINT8_MAX; i++) {
+        append(pps[i]);
+    }
+    return avcC;
+}
+
+bool IsAdts(const uint8_t *data, uint32_t size)
+{
+    constexpr uint8_t syncMask = 0xF6; // the sync word and the layer
+    constexpr uint8_t syncWord = 0xF0;
+    return size >= ADTS_HEADER_SIZE && data[0] == 0xFF && (data[1] & syncMask) == syncWord;
+}
+
+uint32_t GetAdtsHeaderSize(const uint8_t *data)
+{
+    // the crc follows the header when the protection is not absent.
+    return (data[1] & 0x01) ? ADTS_HEADER_SIZE : ADTS_HEADER_SIZE + ADTS_CRC_SIZE;
+}
+
+std::vector<uint8_t> BuildAudioSpecificConfig(uint8_t objectType, int32_t sampleRate, int32_t channels)
+{
+    constexpr uint8_t explicitRateIndex = 0x0F;
+    uint8_t rateIndex = explicitRateIndex;
+    for (size_t i = 0; i < sizeof(AAC_SAMPLE_RATES) / sizeof(AAC_SAMPLE_RATES[0]); i++) {
+        if (AAC_SAMPLE_RATES[i] == sampleRate) {
+            rateIndex = static_cast<uint8_t>(i);
+            break;
+        }
+    }
+    // object type (5 bits), rate index (4 bits), the explicit rate (24 bits) if any, channels (4 bits)
+    uint64_t bits = objectType;
+    uint32_t bitCount = 5; // 5
+    bits = (bits << 4) | rateIndex; // 4
+    bitCount += 4; // 4
+    if (rateIndex == explicitRateIndex) {
+        bits = (bits << 24) | (static_cast<uint32_t>(sampleRate) & 0xFFFFFF); // 24
+        bitCount += 24; // 24
+    }
+    bits = (bits << 4) | (static_cast<uint32_t>(channels) & 0x0F); // 4
+    bitCount += 4; // 4
+    uint32_t byteCount = (bitCount + 7) / 8; // 7, 8
+    bits <<= byteCount * 8 - bitCount; // 8
+    std::vector<uint8_t> config(byteCount);
+    for (uint32_t i = 0; i < byteCount; i++) {
+        config[i] = static_cast<uint8_t>(bits >> ((byteCount - 1 - i) * 8)); // 8
+    }
+    return config;
+}
+
+std::vector<uint8_t> BuildAudioSpecificConfigFromAdts(const uint8_t *data)
+{
+    uint8_t objectType = ((data[2] >> 6) & 0x03) + 1; // 2, 6, the profile is the object type minus 1
+    uint8_t rateIndex = (data[2] >> 2) & 0x0F; // 2
+    uint8_t channels = static_cast<uint8_t>(((data[2] & 0x01) << 2) | ((data[3] >> 6) & 0x03)); // 2, 3, 6
+    return {static_cast<uint8_t>((objectType << 3) | (rateIndex >> 1)), // 3
+        static_cast<uint8_t>(((rateIndex & 0x01) << 7) | (channels << 3))}; // 7, 3
+}
+
+void PutTime(Mp4BoxWriter &writer, uint8_t version, uint64_t value)
+{
+    if (version == 1) {
+        writer.Put64(value);
+    } else {
+        writer.Put32(static_cast<uint32_t>(value));
+    }
+}
+
+void PutMatrix(Mp4BoxWriter &writer, const Matrix &matrix)
+{
+    for (int32_t value : matrix) {
+        writer.Put32(static_cast<uint32_t>(value));
+    }
+}
+
+void PutDescriptor(Mp4BoxWriter &writer, uint8_t tag, uint32_t size)
+{
+    // the length in the 4 bytes form, as most muxers write it.
+    writer.Put8(tag);
+    writer.Put8(static_cast<uint8_t>(0x80 | ((size >> 21) & 0x7F))); // 21
+    writer.Put8(static_cast<uint8_t>(0x80 | ((size >> 14) & 0x7F))); // 14
+    writer.Put8(static_cast<uint8_t>(0x80 | ((size >> 7) & 0x7F))); // 7
+    writer.Put8(static_cast<uint8_t>(size & 0x7F));
+}
+}
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Mp4 {
+Mp4MuxerPlugin::Mp4MuxerPlugin(std::string name, int32_t fd, bool m4a)
+    : MuxerPlugin(std::move(name)), fd_(dup(fd)), m4a_(m4a)
+{
+    AVCODEC_LOGD("0x%{public}06" PRIXPTR " Instances create", FAKE_POINTER(this));
+    if ((fcntl(fd_, F_GETFL, 0) & O_RDWR) != O_RDWR) {
+        AVCODEC_LOGE("No permission to read and write fd");
+    }
+    creationTime_ = static_cast<uint64_t>(time(nullptr)) + MAC_EPOCH_OFFSET;
+}
+
+Mp4MuxerPlugin::~Mp4MuxerPlugin()
+{
+    AVCODEC_LOGD("0x%{public}06" PRIXPTR " Instances destroy", FAKE_POINTER(this));
+    CloseFd();
+}
+
+void Mp4MuxerPlugin::CloseFd()
+{
+    if (fd_ >= 0) {
+        (void)close(fd_);
+        fd_ = -1;
+    }
+}
+
+Status Mp4MuxerPlugin::SetLocation(float latitude, float longitude)
+{
+    latitude_ = latitude;
+    longitude_ = longitude;
+    hasLocation_ = true;
+    return Status::NO_ERROR;
+}
+
+Status Mp4MuxerPlugin::SetRotation(int32_t rotation)
+{
+    rotation_ = rotation;
+    return Status::NO_ERROR;
+}
+
+Status Mp4MuxerPlugin::SetParameter(const MediaDescription &param)
+{
+    // the engine hands the output over to the next plugin of the format when a key is not honoured here, a 0 asks
+    // for the plain synchronous writing that this plugin does anyway.
+    static constexpr std::string_view unsupportedKeys[] = {
+        MediaDescriptionKey::MD_KEY_MUXER_FRAGMENT_DURATION, MediaDescriptionKey::MD_KEY_MUXER_EXPECTED_SIZE,
+        MediaDescriptionKey::MD_KEY_MUXER_IO_BUFFER_SIZE, MediaDescriptionKey::MD_KEY_MUXER_DIRECT_WRITE_THRESHOLD,
+        MediaDescriptionKey::MD_KEY_MUXER_ASYNC_IO, MediaDescriptionKey::MD_KEY_MUXER_WRITE_BEHIND_BUFFERS,
+        MediaDescriptionKey::MD_KEY_MUXER_WRITEBACK_INTERVAL, MediaDescriptionKey::MD_KEY_MUXER_DIRECT_IO,
+    };
+    for (auto key : unsupportedKeys) {
+        CHECK_AND_RETURN_RET_LOG(!HasNonZeroValue(param, key), Status::ERROR_UNIMPLEMENTED,
+            "%{public}s is not supported", std::string(key).c_str());
+    }
+
+    // a key that is not given keeps the value of an earlier call.
+    int64_t expectedDurationUs = expectedDurationUs_;
+    int64_t moovSize = moovSize_;
+    param.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_EXPECTED_DURATION, expectedDurationUs);
+    param.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_MOOV_SIZE, moovSize);
+    CHECK_AND_RETURN_RET_LOG(expectedDurationUs >= 0 && moovSize >= 0 && moovSize <= UINT32_MAX,
+        Status::ERROR_INVALID_PARAMETER, "expected duration %{public}" PRId64 " or moov size %{public}" PRId64
+        " is invalid!", expectedDurationUs, moovSize);
+    expectedDurationUs_ = expectedDurationUs;
+    moovSize_ = moovSize;
+    return Status::NO_ERROR;
+}
+
+Status Mp4MuxerPlugin::AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc)
+{
+    CHECK_AND_RETURN_RET_LOG(!started_, Status::ERROR_WRONG_STATE, "tracks can not be added after Start");
+    std::string mimeType;
+    CHECK_AND_RETURN_RET_LOG(trackDesc.GetStringValue(MediaDescriptionKey::MD_KEY_CODEC_MIME, mimeType),
+        Status::ERROR_MISMATCHED_TYPE, "get mimeType failed!");
+    auto codec = g_mp4Codecs.find(mimeType);
+    CHECK_AND_RETURN_RET_LOG(codec != g_mp4Codecs.end(), Status::ERROR_UNSUPPORTED_FORMAT,
+        "this mimeType do not support! mimeType:%{public}s", mimeType.c_str());
+
+    Track track;
+    track.kind = codec->second.kind;
+    track.sampleEntry = codec->second.sampleEntry;
+    track.objectType = codec->second.objectType;
+    track.coverType = codec->second.coverType;
+    if (track.kind == TrackKind::AUDIO) {
+        CHECK_AND_RETURN_RET_LOG(trackDesc.GetIntValue(MediaDescriptionKey::MD_KEY_SAMPLE_RATE, track.sampleRate) &&
+            track.sampleRate > 0, Status::ERROR_MISMATCHED_TYPE, "get audio sample_rate failed!");
+        CHECK_AND_RETURN_RET_LOG(trackDesc.GetIntValue(MediaDescriptionKey::MD_KEY_CHANNEL_COUNT, track.channels) &&
+            track.channels > 0, Status::ERROR_MISMATCHED_TYPE, "get audio channels failed!");
+        track.timescale = static_cast<uint32_t>(track.sampleRate);
+    } else {
+        bool hasSize = trackDesc.GetIntValue(MediaDescriptionKey::MD_KEY_WIDTH, track.width) &&
+            trackDesc.GetIntValue(MediaDescriptionKey::MD_KEY_HEIGHT, track.height);
+        CHECK_AND_RETURN_RET_LOG(hasSize || track.kind == TrackKind::IMAGE, Status::ERROR_MISMATCHED_TYPE,
+            "get video width or height failed!");
+        track.timescale = VIDEO_TIMESCALE;
+        (void)trackDesc.GetDoubleValue(MediaDescriptionKey::MD_KEY_FRAME_RATE, track.frameRate);
+    }
+    (void)trackDesc.GetLongValue(MediaDescriptionKey::MD_KEY_BITRATE, track.bitrate);
+    (void)trackDesc.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_EXPECTED_DURATION, track.expectedDurationUs);
+
+    uint8_t *config = nullptr;
+    size_t configSize = 0;
+    if (trackDesc.GetBuffer(MediaDescriptionKey::MD_KEY_CODEC_CONFIG, &config, configSize) && configSize > 0) {
+        track.config.assign(config, config + configSize);
+    }
+    if (track.sampleEntry == Fourcc("avc1") && !track.config.empty() && track.config[0] != 1) {
+        // an annex-b config, the samples come with start codes as well.
+        track.config = BuildAvcC(config, static_cast<uint32_t>(configSize));
+        CHECK_AND_RETURN_RET_LOG(!track.config.empty(), Status::ERROR_INVALID_DATA, "the avc config is invalid!");
+        track.annexB = true;
+    }
+    trackIndex = static_cast<int32_t>(tracks_.size());
+    tracks_.push_back(std::move(track));
+    return Status::NO_ERROR;
+}
+
+Status Mp4MuxerPlugin::Start()
+{
+    CHECK_AND_RETURN_RET_LOG(!started_, Status::ERROR_WRONG_STATE, "the muxer is started already");
+    CHECK_AND_RETURN_RET_LOG(fd_ >= 0, Status::ERROR_WRONG_STATE, "the fd is invalid");
+    Mp4BoxWriter writer(fd_, 0);
+    if (m4a_) {
+        writer.Put(M4A_FTYP);
+    } else {
+        writer.Put(MP4_FTYP);
+    }
+    moovPos_ = 0;
+    reservedMoovSize_ = moovSize_ > 0 ? static_cast<uint64_t>(moovSize_) : EstimateReservedMoovSize();
+    if (reservedMoovSize_ >= BOX_HEADER_SIZE) {
+        AVCODEC_LOGI("reserve %{public}" PRIu64 " bytes for moov", reservedMoovSize_);
+        moovPos_ = writer.GetPosition();
+        uint64_t box = writer.Begin(Fourcc("free"));
+        writer.PutZeros(static_cast<size_t>(reservedMoovSize_ - BOX_HEADER_SIZE));
+        writer.End(box);
+    }
+    // the free box is turned into a 64-bit mdat header by FinishMdat when the mdat grows over 4 GiB.
+    mdatPos_ = writer.GetPosition();
+    writer.Put32(BOX_HEADER_SIZE);
+    writer.Put32(Fourcc("free"));
+    writer.Put32(0);
+    writer.Put32(Fourcc("mdat"));
+    CHECK_AND_RETURN_RET_LOG(writer.Flush(), Status::ERROR_UNKNOWN, "write header failed");
+    writePos_ = writer.GetPosition();
+    chunkOffsetShift_ = 0;
+    largeChunkOffsets_ = false;
+    ResetTracks();
+    started_ = true;
+    return Status::NO_ERROR;
+}
+
+void Mp4MuxerPlugin::ResetTracks()
+{
+    for (auto &track : tracks_) {
+        track.started = false;
+        track.hasCtsOffset = false;
+        track.negativeCtsOffset = false;
+        track.sampleSize = 0;
+        track.maxSampleSize = 0;
+        track.bytes = 0;
+        track.lastDelta = 0;
+        if (track.kind != TrackKind::IMAGE) {
+            track.table = std::make_unique<Mp4SampleTable>(MP4_MUXER_SPILL_DIR);
+        }
+    }
+    UpdateTableStatistics();
+}
+
+bool Mp4MuxerPlugin::PrepareFirstSample(Track &track, const uint8_t *data, uint32_t size)
+{
+    if (track.sampleEntry == Fourcc("avc1")) {
+        track.annexB = IsAnnexB(data, size);
+        if (track.config.empty() && track.annexB) {
+            // no codec config, the parameter sets are taken from the first key frame.
+            track.config = BuildAvcC(data, size);
+        }
+        CHECK_AND_RETURN_RET_LOG(!track.config.empty(), false, "no avc config for the track");
+    } else if (track.objectType == OBJECT_TYPE_AAC) {
+        track.adts = IsAdts(data, size);
+        if (track.config.empty()) {
+            track.config = track.adts ? BuildAudioSpecificConfigFromAdts(data) :
+                BuildAudioSpecificConfig(AAC_OBJECT_LC, track.sampleRate, track.channels);
+        }
+    }
+    return true;
+}
+
+uint32_t Mp4MuxerPlugin::BuildIov(const Track &track, uint8_t *data, uint32_t size)
+{
+    // the sample is written from the buffer of the caller, only the nal lengths are made here.
+    iov_.clear();
+    if (track.adts && IsAdts(data, size)) {
+        uint32_t headerSize = std::min(GetAdtsHeaderSize(data), size);
+        iov_.push_back({data + headerSize, size - headerSize});
+        return size - headerSize;
+    }
+    if (!track.annexB || !IsAnnexB(data, size)) {
+        iov_.push_back({data, size});
+        return size;
+    }
+    SplitNalUnits(data, size, nalUnits_);
+    lengthPrefixes_.resize(nalUnits_.size() * NAL_LENGTH_SIZE);
+    uint32_t written = 0;
+    for (size_t i = 0; i < nalUnits_.size(); i++) {
+        uint8_t *prefix = lengthPrefixes_.data() + i * NAL_LENGTH_SIZE;
+        uint32_t nalSize = nalUnits_[i].second;
+        prefix[0] = static_cast<uint8_t>(nalSize >> 24); // 24
+        prefix[1] = static_cast<uint8_t>(nalSize >> 16); // 16
+        prefix[2] = static_cast<uint8_t>(nalSize >> 8); // 2, 8
+        prefix[3] = static_cast<uint8_t>(nalSize); // 3
+        iov_.push_back({prefix, NAL_LENGTH_SIZE});
+        iov_.push_back({data + nalUnits_[i].first, nalSize});
+        written += NAL_LENGTH_SIZE + nalSize;
+    }
+    return written;
+}
+
+bool Mp4MuxerPlugin::WriteIov(uint64_t pos)
+{
+    size_t index = 0;
+    while (index < iov_.size()) {
+        if (iov_[index].iov_len == 0) {
+            index++;
+            continue;
+        }
+        int32_t count = static_cast<int32_t>(std::min(iov_.size() - index, MAX_WRITE_IOV));
+        ssize_t ret = pwritev(fd_, &iov_[index], count, static_cast<off_t>(pos));
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        CHECK_AND_RETURN_RET_LOG(ret > 0, false, "write sample failed, errno %{public}d", errno);
+        pos += static_cast<uint64_t>(ret);
+        size_t done = static_cast<size_t>(ret);
+        while (index < iov_.size() && done >= iov_[index].iov_len) {
+            done -= iov_[index].iov_len;
+            index++;
+        }
+        if (done > 0) {
+            // a short write, go on from the middle of the vector.
+            iov_[index].iov_base = static_cast<uint8_t *>(iov_[index].iov_base) + done;
+            iov_[index].iov_len -= done;
+        }
+    }
+    return true;
+}
+
+Status Mp4MuxerPlugin::WriteSampleBuffer(uint8_t *sampleBuffer, const TrackSampleInfo &info)
+{
+    CHECK_AND_RETURN_RET_LOG(sampleBuffer != nullptr, Status::ERROR_NULL_POINTER, "sampleBuffer is null!");
+    CHECK_AND_RETURN_RET_LOG(started_, Status::ERROR_WRONG_STATE, "the muxer is not started");
+    CHECK_AND_RETURN_RET_LOG(info.trackIndex < tracks_.size(), Status::ERROR_INVALID_PARAMETER,
+        "track index is invalid!");
+    Track &track = tracks_[info.trackIndex];
+    if (track.kind == TrackKind::IMAGE) {
+        // the cover is written into the moov, a later image replaces it.
+        track.image.assign(sampleBuffer, sampleBuffer + info.size);
+        return Status::NO_ERROR;
+    }
+    int64_t dtsUs = info.decodeTimeUs == SAMPLE_TIME_NONE ? info.timeUs : info.decodeTimeUs;
+    if (!track.started) {
+        CHECK_AND_RETURN_RET_LOG(PrepareFirstSample(track, sampleBuffer, info.size), Status::ERROR_INVALID_DATA,
+            "the first sample of track %{public}u is invalid", info.trackIndex);
+        track.firstDtsUs = dtsUs;
+        track.firstPtsUs = info.timeUs;
+    }
+    CHECK_AND_RETURN_RET_LOG(!track.started || dtsUs >= track.lastDtsUs, Status::ERROR_INVALID_PARAMETER,
+        "dts %{public}" PRId64 " of track %{public}u is earlier than the previous one", dtsUs, info.trackIndex);
+
+    uint32_t size = BuildIov(track, sampleBuffer, info.size);
+    auto begin = std::chrono::steady_clock::now();
+    bool written = WriteIov(writePos_);
+    writeTimeUs_ += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - begin).count();
+    CHECK_AND_RETURN_RET_LOG(written, Status::ERROR_UNKNOWN, "write sample buffer failed");
+
+    Mp4SampleTable::Sample sample;
+    sample.dts = RescaleTime(dtsUs - track.firstDtsUs, track.timescale);
+    sample.ctsOffset = static_cast<int32_t>(RescaleTime(info.timeUs - track.firstDtsUs, track.timescale) -
+        sample.dts);
+    sample.size = size;
+    sample.offset = writePos_;
+    sample.sync = track.kind == TrackKind::AUDIO || (info.flags & AVCODEC_BUFFER_FLAG_SYNC_FRAME) != 0;
+    CHECK_AND_RETURN_RET_LOG(track.table->Append(sample), Status::ERROR_INVALID_PARAMETER,
+        "add the sample to the sample table failed");
+    if (!track.started) {
+        track.firstCtsOffset = sample.ctsOffset;
+        track.sampleSize = size;
+        track.started = true;
+    } else {
+        track.lastDelta = sample.dts - track.lastDts;
+        track.sampleSize = (size == track.sampleSize) ? size : 0;
+    }
+    track.hasCtsOffset = track.hasCtsOffset || sample.ctsOffset != 0;
+    track.negativeCtsOffset = track.negativeCtsOffset || sample.ctsOffset < 0;
+    track.maxSampleSize = std::max(track.maxSampleSize, size);
+    track.bytes += size;
+    track.lastDts = sample.dts;
+    track.lastDtsUs = dtsUs;
+    writePos_ += size;
+    samples_++;
+    sampleBytes_ += size;
+    UpdateTableStatistics();
+    return Status::NO_ERROR;
+}
+
+void Mp4MuxerPlugin::UpdateTableStatistics()
+{
+    int64_t memoryBytes = 0;
+    int64_t spilledBytes = 0;
+    for (auto &track : tracks_) {
+        if (track.table != nullptr) {
+            memoryBytes += static_cast<int64_t>(track.table->GetMemoryBytes());
+            spilledBytes += static_cast<int64_t>(track.table->GetSpilledBytes());
+        }
+    }
+    tableMemoryBytes_ = memoryBytes;
+    tableSpilledBytes_ = spilledBytes;
+}
+
+Status Mp4MuxerPlugin::Stop()
+{
+    if (!started_) {
+        CloseFd();
+        return Status::NO_ERROR;
+    }
+    started_ = false;
+    auto begin = std::chrono::steady_clock::now();
+    for (auto &track : tracks_) {
+        if (HasSamples(track)) {
+            track.table->Finish(GetLastDuration(track));
+        }
+    }
+    bool ok = FinishMdat();
+    // the moov goes into the reserved space when it surely fits, so the file is ready for streaming.
+    uint64_t estimated = EstimateMoovSize();
+    bool atFront = moovPos_ > 0 && estimated + BOX_HEADER_SIZE <= reservedMoovSize_;
+    uint64_t moovBegin = moovPos_;
+    uint64_t moovEnd = moovBegin;
+    if (atFront) {
+        ok = WriteMoov(moovBegin, moovEnd) && ok;
+        // what is left of the reserved space stays a free box.
+        Mp4BoxWriter writer(fd_, moovEnd);
+        writer.Put32(static_cast<uint32_t>(moovPos_ + reservedMoovSize_ - moovEnd));
+        writer.Put32(Fourcc("free"));
+        ok = writer.Flush() && ok;
+    } else {
+        if (moovPos_ > 0) {
+            AVCODEC_LOGW("moov may need %{public}" PRIu64 " bytes, more than the reserved %{public}" PRIu64,
+                estimated, reservedMoovSize_);
+        }
+        ok = WriteMoovInFront(moovBegin, moovEnd) && ok;
+    }
+    moovBytes_ = static_cast<int64_t>(moovEnd - moovBegin);
+    moovTimeUs_ = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - begin).count();
+    AVCODEC_LOGI("wrote %{public}" PRId64 " samples, %{public}" PRId64 " bytes in %{public}" PRId64
+        " us, moov %{public}" PRId64 " bytes in %{public}" PRId64 " us", samples_.load(), sampleBytes_.load(),
+        writeTimeUs_.load(), moovBytes_.load(), moovTimeUs_.load());
+    CloseFd();
+    CHECK_AND_RETURN_RET_LOG(ok, Status::ERROR_UNKNOWN, "write trailer failed");
+    return Status::NO_ERROR;
+}
+
+Status Mp4MuxerPlugin::SwitchOutput(int32_t fd)
+{
+    CHECK_AND_RETURN_RET_LOG(fd >= 0, Status::ERROR_INVALID_PARAMETER, "fd %{public}d is invalid!", fd);
+    int32_t newFd = dup(fd);
+    CHECK_AND_RETURN_RET_LOG(newFd >= 0, Status::ERROR_UNKNOWN, "dup fd failed, errno %{public}d", errno);
+    // the current file is finished as by Stop(), the tracks start over in the new one.
+    Status ret = Stop();
+    fd_ = newFd;
+    CHECK_AND_RETURN_RET_LOG(ret == Status::NO_ERROR, ret, "finish the current file failed!");
+    return Start();
+}
+
+Status Mp4MuxerPlugin::GetStatistics(MediaDescription &stats)
+{
+    stats.PutLongValue("mp4_samples", samples_.load());
+    stats.PutLongValue("mp4_sample_bytes", sampleBytes_.load());
+    stats.PutLongValue("mp4_write_time_us", writeTimeUs_.load());
+    stats.PutLongValue("mp4_moov_bytes", moovBytes_.load());
+    stats.PutLongValue("mp4_moov_time_us", moovTimeUs_.load());
+    stats.PutLongValue("mp4_moved_bytes", movedBytes_.load());
+    stats.PutLongValue("mp4_sample_table_memory_bytes", tableMemoryBytes_.load());
+    stats.PutLongValue("mp4_sample_table_spilled_bytes", tableSpilledBytes_.load());
+    return Status::NO_ERROR;
+}
+
+bool Mp4MuxerPlugin::HasSamples(const Track &track) const
+{
+    return track.kind != TrackKind::IMAGE && track.table != nullptr && track.table->GetSummary().sampleCount > 0;
+}
+
+int64_t Mp4MuxerPlugin::GetLastDuration(const Track &track) const
+{
+    if (track.lastDelta > 0) {
+        return track.lastDelta;
+    }
+    if (track.objectType == OBJECT_TYPE_AAC) {
+        return AAC_FRAME_SAMPLES;
+    }
+    if (track.objectType == OBJECT_TYPE_MP3) {
+        return MP3_FRAME_SAMPLES;
+    }
+    double frameRate = track.frameRate > 0.0 ? track.frameRate : DEFAULT_FRAME_RATE;
+    return static_cast<int64_t>(track.timescale / frameRate);
+}
+
+int64_t Mp4MuxerPlugin::GetMovieStart() const
+{
+    int64_t startUs = INT64_MAX;
+    for (auto &track : tracks_) {
+        if (HasSamples(track)) {
+            startUs = std::min(startUs, track.firstPtsUs);
+        }
+    }
+    return startUs == INT64_MAX ? 0 : startUs;
+}
+
+uint64_t Mp4MuxerPlugin::GetTrackDuration(const Track &track, int64_t startUs) const
+{
+    // the empty edit before the track and the presented part of its media, in the movie timescale.
+    int64_t mediaDuration = track.table->GetDuration() - std::max(track.firstCtsOffset, 0);
+    int64_t duration = RescaleTime(std::max<int64_t>(track.firstPtsUs - startUs, 0), MOVIE_TIMESCALE) +
+        std::max<int64_t>(mediaDuration, 0) * MOVIE_TIMESCALE / track.timescale;
+    return static_cast<uint64_t>(duration);
+}
+
+uint64_t Mp4MuxerPlugin::EstimateMoovSize() const
+{
+    uint64_t size = MOOV_MOVIE_OVERHEAD;
+    for (auto &track : tracks_) {
+        if (track.kind == TrackKind::IMAGE) {
+            size += MOOV_TRACK_OVERHEAD + track.image.size();
+            continue;
+        }
+        if (!HasSamples(track)) {
+            continue;
+        }
+        const auto &summary = track.table->GetSummary();
+        size += MOOV_TRACK_OVERHEAD + track.config.size() + summary.sttsEntries * STTS_ENTRY_SIZE +
+            summary.cttsEntries * CTTS_ENTRY_SIZE + summary.syncSamples * STSS_ENTRY_SIZE +
+            summary.stscEntries * STSC_ENTRY_SIZE + summary.sampleCount * STSZ_ENTRY_SIZE +
+            summary.chunkCount * (summary.largeOffsets ? CO64_ENTRY_SIZE : STCO_ENTRY_SIZE);
+    }
+    return size;
+}
+
+uint64_t Mp4MuxerPlugin::EstimateReservedMoovSize() const
+{
+    // the same upper bound as EstimateMoovSize, with the samples expected from the duration of each track.
+    uint64_t size = MOOV_MOVIE_OVERHEAD;
+    uint64_t expectedBytes = 0;
+    bool hasDuration = false;
+    std::vector<uint64_t> trackSamples;
+    for (auto &track : tracks_) {
+        int64_t durationUs = track.expectedDurationUs > 0 ? track.expectedDurationUs : expectedDurationUs_;
+        if (track.kind == TrackKind::IMAGE || durationUs <= 0) {
+            trackSamples.push_back(track.kind == TrackKind::IMAGE ? 1 : 0);
+            continue;
+        }
+        hasDuration = true;
+        int64_t samples = OTHER_SAMPLES_PER_SEC * durationUs / USEC_PER_SEC;
+        if (track.kind == TrackKind::VIDEO) {
+            double frameRate = track.frameRate > 0.0 ? track.frameRate : DEFAULT_FRAME_RATE;
+            samples = static_cast<int64_t>(frameRate * durationUs / USEC_PER_SEC);
+        } else if (track.kind == TrackKind::AUDIO) {
+            int64_t frameSamples = track.objectType == OBJECT_TYPE_MP3 ? MP3_FRAME_SAMPLES : AAC_FRAME_SAMPLES;
+            samples = track.sampleRate * durationUs / USEC_PER_SEC / frameSamples;
+        }
+        trackSamples.push_back(static_cast<uint64_t>(samples) + 1);
+        int64_t bytesPerSec = std::max<int64_t>(track.bitrate, 0) / 8; // 8
+        expectedBytes += static_cast<uint64_t>(bytesPerSec * durationUs / USEC_PER_SEC);
+    }
+    if (!hasDuration) {
+        return 0;
+    }
+    uint64_t offsetSize = expectedBytes > UINT32_MAX ? CO64_ENTRY_SIZE : STCO_ENTRY_SIZE;
+    for (size_t i = 0; i < tracks_.size(); i++) {
+        const Track &track = tracks_[i];
+        uint64_t sampleSize = STTS_ENTRY_SIZE + STSC_ENTRY_SIZE + STSZ_ENTRY_SIZE + offsetSize;
+        if (track.kind == TrackKind::VIDEO) {
+            sampleSize += CTTS_ENTRY_SIZE + STSS_ENTRY_SIZE;
+        }
+        size += MOOV_TRACK_OVERHEAD + track.config.size() + trackSamples[i] * sampleSize;
+    }
+    return std::min<uint64_t>(size + size / MOOV_MARGIN_DIVISOR, UINT32_MAX);
+}
+
+bool Mp4MuxerPlugin::WriteMoovInFront(uint64_t &moovBegin, uint64_t &moovEnd)
+{
+    // as the faststart of a general purpose muxer: the moov is measured at the end of the file, the media data
+    // moves up by what the reserved space lacks, then the moov is written in front of it.
+    uint64_t front = moovPos_ > 0 ? moovPos_ : mdatPos_;
+    uint64_t available = moovPos_ > 0 ? reservedMoovSize_ : 0;
+    // the shift is not known before the measuring, the width of the chunk offsets must not change with it.
+    largeChunkOffsets_ = writePos_ + EstimateMoovSize() > UINT32_MAX;
+    chunkOffsetShift_ = 0;
+    uint64_t end = writePos_;
+    bool ok = WriteMoov(writePos_, end);
+    uint64_t moovSize = end - writePos_;
+    CHECK_AND_RETURN_RET_LOG(ok, false, "write moov failed");
+    if (moovSize + BOX_HEADER_SIZE <= available || moovSize == available) {
+        // the estimate is an upper bound, the moov fits after all.
+        moovBegin = front;
+        ok = WriteMoov(moovBegin, moovEnd);
+        if (moovEnd < front + available) {
+            Mp4BoxWriter writer(fd_, moovEnd);
+            writer.Put32(static_cast<uint32_t>(front + available - moovEnd));
+            writer.Put32(Fourcc("free"));
+            ok = writer.Flush() && ok;
+        }
+        return ftruncate(fd_, static_cast<off_t>(writePos_)) == 0 && ok;
+    }
+    uint64_t shift = moovSize - available;
+    auto begin = std::chrono::steady_clock::now();
+    CHECK_AND_RETURN_RET_LOG(MoveData(fd_, mdatPos_, writePos_, shift), false, "move the media data failed");
+    AVCODEC_LOGI("moved %{public}" PRIu64 " bytes of media data up by %{public}" PRIu64 " in %{public}" PRId64
+        " us for the moov", writePos_ - mdatPos_, shift, static_cast<int64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count()));
+    movedBytes_ += static_cast<int64_t>(writePos_ - mdatPos_);
+    chunkOffsetShift_ = shift;
+    moovBegin = front;
+    ok = WriteMoov(moovBegin, moovEnd);
+    // the moov measured at the end is overwritten by the moved data up to here, the rest is cut off.
+    ok = ftruncate(fd_, static_cast<off_t>(writePos_ + shift)) == 0 && ok;
+    chunkOffsetShift_ = 0;
+    largeChunkOffsets_ = false;
+    return ok;
+}
+
+bool Mp4MuxerPlugin::FinishMdat()
+{
+    Mp4BoxWriter writer(fd_, mdatPos_);
+    uint64_t mdatSize = writePos_ - mdatPos_ - BOX_HEADER_SIZE;
+    if (mdatSize <= UINT32_MAX) {
+        writer.Put32(BOX_HEADER_SIZE);
+        writer.Put32(Fourcc("free"));
+        writer.Put32(static_cast<uint32_t>(mdatSize));
+    } else {
+        // the free box and the mdat header become one 64-bit mdat header.
+        writer.Put32(1);
+        writer.Put32(Fourcc("mdat"));
+        writer.Put64(writePos_ - mdatPos_);
+    }
+    return writer.Flush();
+}
+
+bool Mp4MuxerPlugin::WriteMoov(uint64_t pos, uint64_t &end)
+{
+    Mp4BoxWriter writer(fd_, pos);
+    int64_t startUs = GetMovieStart();
+    uint64_t duration = 0;
+    uint32_t trackCount = 0;
+    for (auto &track : tracks_) {
+        if (HasSamples(track)) {
+            duration = std::max(duration, GetTrackDuration(track, startUs));
+            trackCount++;
+        }
+    }
+    bool ok = true;
+    uint64_t moov = writer.Begin(Fourcc("moov"));
+    WriteMvhd(writer, duration, trackCount + 1);
+    uint32_t trackId = 1;
+    for (auto &track : tracks_) {
+        if (HasSamples(track)) {
+            ok = WriteTrak(writer, track, trackId++, startUs) && ok;
+        }
+    }
+    WriteUdta(writer);
+    writer.End(moov);
+    ok = writer.Flush() && ok;
+    end = writer.GetPosition();
+    return ok;
+}
+
+void Mp4MuxerPlugin::WriteMvhd(Mp4BoxWriter &writer, uint64_t duration, uint32_t nextTrackId)
+{
+    uint8_t version = duration > UINT32_MAX ? 1 : 0;
+    uint64_t box = writer.BeginFull(Fourcc("mvhd"), version, 0);
+    PutTime(writer, version, creationTime_);
+    PutTime(writer, version, creationTime_);
+    writer.Put32(MOVIE_TIMESCALE);
+    PutTime(writer, version, duration);
+    writer.Put32(FIXED_ONE); // rate
+    writer.Put16(VOLUME_ONE);
+    writer.PutZeros(10); // 10 bytes reserved
+    PutMatrix(writer, IDENTITY_MATRIX);
+    writer.PutZeros(24); // 24 bytes pre_defined
+    writer.Put32(nextTrackId);
+    writer.End(box);
+}
+
+bool Mp4MuxerPlugin::WriteTrak(Mp4BoxWriter &writer, const Track &track, uint32_t trackId, int64_t startUs)
+{
+    uint64_t box = writer.Begin(Fourcc("trak"));
+    WriteTkhd(writer, track, trackId, GetTrackDuration(track, startUs));
+    WriteEdts(writer, track, startUs);
+    bool ok = WriteMdia(writer, track, trackId);
+    writer.End(box);
+    return ok;
+}
+
+void Mp4MuxerPlugin::WriteTkhd(Mp4BoxWriter &writer, const Track &track, uint32_t trackId, uint64_t duration)
+{
+    constexpr uint32_t trackEnabledInMovie = 0x03;
+    uint8_t version = duration > UINT32_MAX ? 1 : 0;
+    bool audio = track.kind == TrackKind::AUDIO;
+    uint64_t box = writer.BeginFull(Fourcc("tkhd"), version, trackEnabledInMovie);
+    PutTime(writer, version, creationTime_);
+    PutTime(writer, version, creationTime_);
+    writer.Put32(trackId);
+    writer.Put32(0); // reserved
+    PutTime(writer, version, duration);
+    writer.PutZeros(8); // 8 bytes reserved
+    writer.Put16(0); // layer
+    writer.Put16(audio ? 1 : 0); // alternate group
+    writer.Put16(audio ? VOLUME_ONE : 0);
+    writer.Put16(0); // reserved
+    const Matrix *matrix = &IDENTITY_MATRIX;
+    if (!audio) {
+        switch (rotation_) {
+            case VIDEO_ROTATION_90:
+                matrix = &ROTATION_90_MATRIX;
+                break;
+            case VIDEO_ROTATION_180:
+                matrix = &ROTATION_180_MATRIX;
+                break;
+            case VIDEO_ROTATION_270:
+                matrix = &ROTATION_270_MATRIX;
+                break;
+            default:
+                break;
+        }
+    }
+    PutMatrix(writer, *matrix);
+    writer.Put32(audio ? 0 : static_cast<uint32_t>(track.width) << 16); // 16.16
+    writer.Put32(audio ? 0 : static_cast<uint32_t>(track.height) << 16); // 16.16
+    writer.End(box);
+}
+
+void Mp4MuxerPlugin::WriteEdts(Mp4BoxWriter &writer, const Track &track, int64_t startUs)
+{
+    // an empty edit delays a track that starts after the movie, the media edit skips the decoding delay.
+    int64_t delay = RescaleTime(std::max<int64_t>(track.firstPtsUs - startUs, 0), MOVIE_TIMESCALE);
+    int64_t mediaTime = std::max(track.firstCtsOffset, 0);
+    if (delay == 0 && mediaTime == 0) {
+        return;
+    }
+    int64_t mediaDuration = std::max<int64_t>(track.table->GetDuration() - mediaTime, 0) * MOVIE_TIMESCALE /
+        track.timescale;
+    uint8_t version = (static_cast<uint64_t>(delay) > UINT32_MAX ||
+        static_cast<uint64_t>(mediaDuration) > UINT32_MAX || mediaTime > INT32_MAX) ? 1 : 0;
+    uint64_t edts = writer.Begin(Fourcc("edts"));
+    uint64_t elst = writer.BeginFull(Fourcc("elst"), version, 0);
+    writer.Put32(delay > 0 ? 2 : 1); // 2 entries with the empty edit
+    if (delay > 0) {
+        PutTime(writer, version, static_cast<uint64_t>(delay));
+        PutTime(writer, version, version == 1 ? UINT64_MAX : UINT32_MAX); // media time -1
+        writer.Put32(FIXED_ONE); // media rate
+    }
+    PutTime(writer, version, static_cast<uint64_t>(mediaDuration));
+    PutTime(writer, version, static_cast<uint64_t>(mediaTime));
+    writer.Put32(FIXED_ONE);
+    writer.End(elst);
+    writer.End(edts);
+}
+
+bool Mp4MuxerPlugin::WriteMdia(Mp4BoxWriter &writer, const Track &track, uint32_t trackId)
+{
+    uint64_t mdia = writer.Begin(Fourcc("mdia"));
+    uint64_t duration = static_cast<uint64_t>(track.table->GetDuration());
+    uint8_t version = duration > UINT32_MAX ? 1 : 0;
+    uint64_t mdhd = writer.BeginFull(Fourcc("mdhd"), version, 0);
+    PutTime(writer, version, creationTime_);
+    PutTime(writer, version, creationTime_);
+    writer.Put32(track.timescale);
+    PutTime(writer, version, duration);
+    writer.Put16(LANGUAGE_UND);
+    writer.Put16(0); // pre_defined
+    writer.End(mdhd);
+    bool audio = track.kind == TrackKind::AUDIO;
+    if (audio) {
+        writer.Put(SOUND_HDLR);
+    } else {
+        writer.Put(VIDEO_HDLR);
+    }
+    uint64_t minf = writer.Begin(Fourcc("minf"));
+    if (audio) {
+        writer.Put(SMHD_BOX);
+    } else {
+        writer.Put(VMHD_BOX);
+    }
+    writer.Put(DINF_BOX);
+    bool ok = WriteStbl(writer, track, trackId);
+    writer.End(minf);
+    writer.End(mdia);
+    return ok;
+}
+
+void Mp4MuxerPlugin::WriteStsd(Mp4BoxWriter &writer, const Track &track, uint32_t trackId)
+{
+    constexpr uint32_t compressorNameSize = 32;
+    constexpr uint16_t videoDepth = 0x18;
+    constexpr uint16_t audioSampleSize = 16;
+    uint64_t stsd = writer.BeginFull(Fourcc("stsd"), 0, 0);
+    writer.Put32(1); // entry count
+    uint64_t entry = writer.Begin(track.sampleEntry);
+    writer.PutZeros(6); // 6 bytes reserved
+    writer.Put16(1); // data reference index
+    if (track.kind == TrackKind::AUDIO) {
+        writer.PutZeros(8); // 8 bytes reserved
+        writer.Put16(static_cast<uint16_t>(track.channels));
+        writer.Put16(audioSampleSize);
+        writer.Put32(0); // pre_defined and reserved
+        writer.Put32(track.sampleRate <= UINT16_MAX ? static_cast<uint32_t>(track.sampleRate) << 16 : 0); // 16.16
+        WriteEsds(writer, track, trackId);
+    } else {
+        writer.PutZeros(16); // 16 bytes pre_defined and reserved
+        writer.Put16(static_cast<uint16_t>(track.width));
+        writer.Put16(static_cast<uint16_t>(track.height));
+        writer.Put32(RESOLUTION_72_DPI);
+        writer.Put32(RESOLUTION_72_DPI);
+        writer.Put32(0); // reserved
+        writer.Put16(1); // frame count
+        writer.PutZeros(compressorNameSize);
+        writer.Put16(videoDepth);
+        writer.Put16(UINT16_MAX); // pre_defined -1
+        if (track.sampleEntry == Fourcc("avc1")) {
+            uint64_t avcC = writer.Begin(Fourcc("avcC"));
+            writer.PutBytes(track.config.data(), track.config.size());
+            writer.End(avcC);
+        } else {
+            WriteEsds(writer, track, trackId);
+        }
+    }
+    writer.End(entry);
+    writer.End(stsd);
+}
+
+void Mp4MuxerPlugin::WriteEsds(Mp4BoxWriter &writer, const Track &track, uint32_t trackId)
+{
+    constexpr uint8_t esDescrTag = 0x03;
+    constexpr uint8_t decoderConfigDescrTag = 0x04;
+    constexpr uint8_t decSpecificInfoTag = 0x05;
+    constexpr uint8_t slConfigDescrTag = 0x06;
+    constexpr uint32_t descriptorHeaderSize = 5;
+    constexpr uint32_t esHeaderSize = 3;
+    constexpr uint32_t decoderConfigHeaderSize = 13;
+    constexpr uint8_t slPredefinedMp4 = 0x02;
+    uint32_t configSize = static_cast<uint32_t>(track.config.size());
+    uint32_t decoderConfigSize = decoderConfigHeaderSize + (configSize > 0 ? descriptorHeaderSize + configSize : 0);
+    uint32_t esSize = esHeaderSize + descriptorHeaderSize + decoderConfigSize + descriptorHeaderSize + 1;
+
+    int64_t duration = track.table->GetDuration();
+    uint64_t avgBitrate = duration > 0 ? track.bytes * 8 * track.timescale / static_cast<uint64_t>(duration) : 0; // 8
+    uint64_t maxBitrate = std::max<uint64_t>(avgBitrate, track.bitrate > 0 ? track.bitrate : 0);
+
+    uint64_t esds = writer.BeginFull(Fourcc("esds"), 0, 0);
+    PutDescriptor(writer, esDescrTag, esSize);
+    writer.Put16(static_cast<uint16_t>(trackId));
+    writer.Put8(0); // flags
+    PutDescriptor(writer, decoderConfigDescrTag, decoderConfigSize);
+    writer.Put8(track.objectType);
+    writer.Put8(track.kind == TrackKind::AUDIO ? STREAM_TYPE_AUDIO : STREAM_TYPE_VIDEO);
+    writer.Put24(std::min<uint32_t>(track.maxSampleSize, 0xFFFFFF)); // buffer size in 24 bits
+    writer.Put32(static_cast<uint32_t>(std::min<uint64_t>(maxBitrate, UINT32_MAX)));
+    writer.Put32(static_cast<uint32_t>(std::min<uint64_t>(avgBitrate, UINT32_MAX)));
+    if (configSize > 0) {
+        PutDescriptor(writer, decSpecificInfoTag, configSize);
+        writer.PutBytes(track.config.data(), configSize);
+    }
+    PutDescriptor(writer, slConfigDescrTag, 1);
+    writer.Put8(slPredefinedMp4);
+    writer.End(esds);
+}
+
+bool Mp4MuxerPlugin::WriteStbl(Mp4BoxWriter &writer, const Track &track, uint32_t trackId)
+{
+    const Mp4SampleTable &table = *track.table;
+    const auto &summary = table.GetSummary();
+    bool ok = true;
+    uint64_t stbl = writer.Begin(Fourcc("stbl"));
+    WriteStsd(writer, track, trackId);
+
+    // stts and ctts are run-length coded, their entry counts are patched after the runs.
+    uint64_t stts = writer.BeginFull(Fourcc("stts"), 0, 0);
+    uint64_t countPos = writer.GetPosition();
+    writer.Put32(0);
+    uint32_t entries = 0;
+    uint32_t runLength = 0;
+    int64_t runValue = 0;
+    auto flushRun = [&writer, &entries, &runLength, &runValue]() {
+        if (runLength > 0) {
+            writer.Put32(runLength);
+            writer.Put32(static_cast<uint32_t>(runValue));
+            entries++;
+        }
+    };
+    ok = table.ForEach([&](const Mp4SampleTable::Sample &sample, uint32_t) {
+        if (runLength == 0 || sample.duration != runValue) {
+            flushRun();
+            runValue = sample.duration;
+            runLength = 0;
+        }
+        runLength++;
+        return true;
+    }) && ok;
+    flushRun();
+    writer.Patch32(countPos, entries);
+    writer.End(stts);
+
+    if (track.hasCtsOffset) {
+        uint64_t ctts = writer.BeginFull(Fourcc("ctts"), track.negativeCtsOffset ? 1 : 0, 0);
+        countPos = writer.GetPosition();
+        writer.Put32(0);
+        entries = 0;
+        runLength = 0;
+        ok = table.ForEach([&](const Mp4SampleTable::Sample &sample, uint32_t) {
+            if (runLength == 0 || sample.ctsOffset != runValue) {
+                flushRun();
+                runValue = sample.ctsOffset;
+                runLength = 0;
+            }
+            runLength++;
+            return true;
+        }) && ok;
+        flushRun();
+        writer.Patch32(countPos, entries);
+        writer.End(ctts);
+    }
+
+    if (summary.syncSamples < summary.sampleCount) {
+        uint64_t stss = writer.BeginFull(Fourcc("stss"), 0, 0);
+        writer.Put32(summary.syncSamples);
+        ok = table.ForEach([&writer](const Mp4SampleTable::Sample &sample, uint32_t index) {
+            if (sample.sync) {
+                writer.Put32(index + 1);
+            }
+            return true;
+        }) && ok;
+        writer.End(stss);
+    }
+
+    uint64_t stsc = writer.BeginFull(Fourcc("stsc"), 0, 0);
+    countPos = writer.GetPosition();
+    writer.Put32(0);
+    entries = 0;
+    uint32_t chunk = 0;
+    uint32_t lastSamples = 0;
+    ok = table.ForEachChunk([&](uint64_t, uint32_t samples) {
+        chunk++;
+        if (samples != lastSamples) {
+            writer.Put32(chunk);
+            writer.Put32(samples);
+            writer.Put32(1); // sample description index
+            lastSamples = samples;
+            entries++;
+        }
+        return true;
+    }) && ok;
+    writer.Patch32(countPos, entries);
+    writer.End(stsc);
+
+    uint64_t stsz = writer.BeginFull(Fourcc("stsz"), 0, 0);
+    writer.Put32(track.sampleSize);
+    writer.Put32(summary.sampleCount);
+    if (track.sampleSize == 0) {
+        ok = table.ForEach([&writer](const Mp4SampleTable::Sample &sample, uint32_t) {
+            writer.Put32(sample.size);
+            return true;
+        }) && ok;
+    }
+    writer.End(stsz);
+
+    // 64-bit chunk offsets only for the tracks with chunks beyond 4 GiB.
+    bool largeOffsets = summary.largeOffsets || largeChunkOffsets_;
+    uint64_t shift = chunkOffsetShift_;
+    uint64_t stco = writer.BeginFull(largeOffsets ? Fourcc("co64") : Fourcc("stco"), 0, 0);
+    writer.Put32(chunk);
+    ok = table.ForEachChunk([&writer, largeOffsets, shift](uint64_t offset, uint32_t) {
+        if (largeOffsets) {
+            writer.Put64(offset + shift);
+        } else {
+            writer.Put32(static_cast<uint32_t>(offset + shift));
+        }
+        return true;
+    }) && ok;
+    writer.End(stco);
+    writer.End(stbl);
+    return ok;
+}
+
+void Mp4MuxerPlugin::WriteUdta(Mp4BoxWriter &writer)
+{
+    const Track *cover = nullptr;
+    for (auto &track : tracks_) {
+        if (track.kind == TrackKind::IMAGE && !track.image.empty()) {
+            cover = &track;
+            break;
+        }
+    }
+    if (!hasLocation_ && cover == nullptr) {
+        return;
+    }
+    uint64_t udta = writer.Begin(Fourcc("udta"));
+    if (hasLocation_) {
+        constexpr size_t locationSize = 32;
+        char location[locationSize] = {0};
+        int32_t len = snprintf(location, sizeof(location), "%+08.4f%+09.4f/", latitude_, longitude_);
+        if (len > 0 && static_cast<size_t>(len) < sizeof(location)) {
+            uint64_t xyz = writer.Begin(0xA978797A); // (c)xyz
+            writer.Put16(static_cast<uint16_t>(len));
+            writer.Put16(LANGUAGE_LOCATION);
+            writer.PutBytes(reinterpret_cast<const uint8_t *>(location), static_cast<size_t>(len));
+            writer.End(xyz);
+        }
+    }
+    if (cover != nullptr) {
+        uint64_t meta = writer.BeginFull(Fourcc("meta"), 0, 0);
+        writer.Put(METADATA_HDLR);
+        uint64_t ilst = writer.Begin(Fourcc("ilst"));
+        uint64_t covr = writer.Begin(Fourcc("covr"));
+        uint64_t data = writer.Begin(Fourcc("data"));
+        writer.Put32(cover->coverType);
+        writer.Put32(0); // locale
+        writer.PutBytes(cover->image.data(), cover->image.size());
+        writer.End(data);
+        writer.End(covr);
+        writer.End(ilst);
+        writer.End(meta);
+    }
+    writer.End(udta);
+}
+} // Mp4
+} // Plugin
+} // Media
+} // OHOS
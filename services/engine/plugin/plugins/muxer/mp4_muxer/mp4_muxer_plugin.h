@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MP4_MUXER_PLUGIN_H
+#define MP4_MUXER_PLUGIN_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <sys/uio.h>
+#include "muxer_plugin.h"
+#include "mp4_box_writer.h"
+#include "mp4_sample_table.h"
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Mp4 {
+/**
+ * Writes MP4 and M4A files without a general purpose muxer in between. The samples go from the buffer of the
+ * caller to the mdat with one pwritev, the sample tables are kept by Mp4SampleTable and the moov is written
+ * from them at Stop(), into the space reserved at the head of the file when it fits. Otherwise the media data
+ * is moved up to make room for it, so the moov is always in front of the media data.
+ */
+class Mp4MuxerPlugin : public MuxerPlugin {
+public:
+    Mp4MuxerPlugin(std::string name, int32_t fd, bool m4a);
+    ~Mp4MuxerPlugin() override;
+
+    Status SetLocation(float latitude, float longitude) override;
+    Status SetRotation(int32_t rotation) override;
+    Status SetParameter(const MediaDescription &param) override;
+    Status AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc) override;
+    Status Start() override;
+    Status WriteSampleBuffer(uint8_t *sampleBuffer, const TrackSampleInfo &info) override;
+    Status Stop() override;
+    Status GetStatistics(MediaDescription &stats) override;
+    Status SwitchOutput(int32_t fd) override;
+
+    enum class TrackKind : uint8_t {
+        VIDEO,
+        AUDIO,
+        IMAGE,
+    };
+
+private:
+    struct Track {
+        TrackKind kind = TrackKind::VIDEO;
+        uint32_t sampleEntry = 0; // avc1, mp4v or mp4a
+        uint8_t objectType = 0; // of the esds
+        uint32_t coverType = 0; // the data type of an image track in the covr box
+        int32_t width = 0;
+        int32_t height = 0;
+        int32_t sampleRate = 0;
+        int32_t channels = 0;
+        int64_t bitrate = 0;
+        double frameRate = 0.0;
+        uint32_t timescale = 0;
+        std::vector<uint8_t> config; // the avcC payload or the decoder specific info
+        bool annexB = false; // the samples have start codes, they are written with length prefixes
+        bool adts = false; // the samples have adts headers, they are written without them
+        std::unique_ptr<Mp4SampleTable> table;
+        bool started = false;
+        int64_t firstDtsUs = 0;
+        int64_t firstPtsUs = 0;
+        int64_t lastDtsUs = 0;
+        int64_t lastDts = 0; // in the timescale of the track
+        int64_t lastDelta = 0;
+        int32_t firstCtsOffset = 0;
+        bool hasCtsOffset = false;
+        bool negativeCtsOffset = false;
+        uint32_t sampleSize = 0; // all samples have this size, 0 when they differ
+        uint32_t maxSampleSize = 0;
+        uint64_t bytes = 0;
+        int64_t expectedDurationUs = 0; // the hint of this track, the one of the muxer without it
+        std::vector<uint8_t> image; // an image track is written as the cover
+    };
+
+    bool PrepareFirstSample(Track &track, const uint8_t *data, uint32_t size);
+    uint32_t BuildIov(const Track &track, uint8_t *data, uint32_t size);
+    bool WriteIov(uint64_t pos);
+    void ResetTracks();
+    void UpdateTableStatistics();
+    int64_t GetLastDuration(const Track &track) const;
+    bool HasSamples(const Track &track) const;
+    int64_t GetMovieStart() const;
+    uint64_t GetTrackDuration(const Track &track, int64_t startUs) const;
+    uint64_t EstimateMoovSize() const;
+    uint64_t EstimateReservedMoovSize() const;
+    bool FinishMdat();
+    bool WriteMoov(uint64_t pos, uint64_t &end);
+    bool WriteMoovInFront(uint64_t &moovBegin, uint64_t &moovEnd);
+    void WriteMvhd(Mp4BoxWriter &writer, uint64_t duration, uint32_t nextTrackId);
+    bool WriteTrak(Mp4BoxWriter &writer, const Track &track, uint32_t trackId, int64_t startUs);
+    void WriteTkhd(Mp4BoxWriter &writer, const Track &track, uint32_t trackId, uint64_t duration);
+    void WriteEdts(Mp4BoxWriter &writer, const Track &track, int64_t startUs);
+    bool WriteMdia(Mp4BoxWriter &writer, const Track &track, uint32_t trackId);
+    void WriteStsd(Mp4BoxWriter &writer, const Track &track, uint32_t trackId);
+    void WriteEsds(Mp4BoxWriter &writer, const Track &track, uint32_t trackId);
+    bool WriteStbl(Mp4BoxWriter &writer, const Track &track, uint32_t trackId);
+    void WriteUdta(Mp4BoxWriter &writer);
+    void CloseFd();
+
+    int32_t fd_ = -1;
+    bool m4a_ = false;
+    bool started_ = false;
+    int32_t rotation_ = 0;
+    bool hasLocation_ = false;
+    float latitude_ = 0.0f;
+    float longitude_ = 0.0f;
+    int64_t moovSize_ = 0;
+    int64_t expectedDurationUs_ = 0;
+    uint64_t reservedMoovSize_ = 0;
+    uint64_t creationTime_ = 0;
+    std::vector<Track> tracks_;
+    uint64_t moovPos_ = 0; // the free box reserved for the moov, 0 without one
+    uint64_t mdatPos_ = 0; // the free box that becomes the header of an mdat over 4 GiB
+    uint64_t writePos_ = 0;
+    uint64_t chunkOffsetShift_ = 0; // the media data moved up by this to make room for the moov
+    bool largeChunkOffsets_ = false; // co64 for all the tracks, the shifted offsets may pass 4 GiB
+    std::vector<struct iovec> iov_;
+    std::vector<std::pair<uint32_t, uint32_t>> nalUnits_; // the offset and the size of each nal unit
+    std::vector<uint8_t> lengthPrefixes_;
+
+    std::atomic<int64_t> samples_ {0};
+    std::atomic<int64_t> sampleBytes_ {0};
+    std::atomic<int64_t> writeTimeUs_ {0};
+    std::atomic<int64_t> moovBytes_ {0};
+    std::atomic<int64_t> moovTimeUs_ {0};
+    std::atomic<int64_t> movedBytes_ {0};
+    std::atomic<int64_t> tableMemoryBytes_ {0};
+    std::atomic<int64_t> tableSpilledBytes_ {0};
+};
+} // Mp4
+} // Plugin
+} // Media
+} // OHOS
+#endif // MP4_MUXER_PLUGIN_H
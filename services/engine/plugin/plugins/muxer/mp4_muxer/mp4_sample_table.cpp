@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mp4_sample_table.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "avcodec_log.h"
+
+namespace {
+    constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "Mp4SampleTable"};
+    constexpr uint64_t MAX_STCO_OFFSET = UINT32_MAX;
+    constexpr uint64_t SPILL_RETRY_FACTOR = 2;
+}
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Mp4 {
+Mp4SampleTable::Mp4SampleTable(std::string spillDir, uint32_t runSamples)
+    : spillDir_(std::move(spillDir)), runSamples_(std::max<uint32_t>(runSamples, 1)), nextSpillSamples_(runSamples_)
+{
+    run_.reserve(runSamples_);
+}
+
+Mp4SampleTable::~Mp4SampleTable()
+{
+    if (spillFd_ >= 0) {
+        close(spillFd_);
+        spillFd_ = -1;
+    }
+}
+
+bool Mp4SampleTable::Append(const Sample &sample)
+{
+    CHECK_AND_RETURN_RET_LOG(summary_.sampleCount < UINT32_MAX, false, "too many samples");
+    CHECK_AND_RETURN_RET_LOG(!hasLast_ || sample.dts >= last_.dts, false,
+        "dts %{public}" PRId64 " is earlier than the previous one", sample.dts);
+    UpdateSummary(sample);
+    run_.push_back({sample.dts, sample.offset, sample.size, sample.ctsOffset, static_cast<uint8_t>(sample.sync)});
+    if (run_.size() >= nextSpillSamples_) {
+        return Spill();
+    }
+    return true;
+}
+
+void Mp4SampleTable::UpdateSummary(const Sample &sample)
+{
+    if (!hasLast_) {
+        firstDts_ = sample.dts;
+        summary_.cttsEntries = 1;
+        summary_.chunkCount = 1;
+        chunkSamples_ = 1;
+    } else {
+        // the duration of the previous sample is only known now.
+        int64_t delta = sample.dts - last_.dts;
+        if (delta != lastDelta_) {
+            summary_.sttsEntries++;
+            lastDelta_ = delta;
+        }
+        if (sample.ctsOffset != lastCtsOffset_) {
+            summary_.cttsEntries++;
+        }
+        if (sample.offset == last_.offset + last_.size) {
+            chunkSamples_++;
+        } else {
+            // a new chunk, the samples per chunk of the previous one go into stsc when they change.
+            if (chunkSamples_ != lastChunkSamples_) {
+                summary_.stscEntries++;
+                lastChunkSamples_ = chunkSamples_;
+            }
+            summary_.chunkCount++;
+            chunkSamples_ = 1;
+        }
+    }
+    lastCtsOffset_ = sample.ctsOffset;
+    if (sample.sync) {
+        summary_.syncSamples++;
+    }
+    if (sample.offset + sample.size > MAX_STCO_OFFSET) {
+        summary_.largeOffsets = true;
+    }
+    summary_.sampleCount++;
+    last_ = sample;
+    hasLast_ = true;
+}
+
+void Mp4SampleTable::Finish(int64_t lastDuration)
+{
+    if (!hasLast_) {
+        return;
+    }
+    lastDuration_ = lastDuration;
+    if (lastDuration != lastDelta_) {
+        summary_.sttsEntries++;
+    }
+    if (chunkSamples_ != lastChunkSamples_) {
+        summary_.stscEntries++;
+    }
+}
+
+int64_t Mp4SampleTable::GetDuration() const
+{
+    return hasLast_ ? last_.dts - firstDts_ + lastDuration_ : 0;
+}
+
+bool Mp4SampleTable::Spill()
+{
+    if (spillFd_ < 0 && !OpenSpillFile()) {
+        // keeping the samples in memory is better than losing the recording, the file is tried again once the run
+        // has doubled, not on every sample.
+        nextSpillSamples_ = run_.size() * SPILL_RETRY_FACTOR;
+        return true;
+    }
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(run_.data());
+    size_t size = run_.size() * sizeof(Record);
+    off_t pos = static_cast<off_t>(spilledRecords_ * sizeof(Record));
+    size_t done = 0;
+    while (done < size) {
+        ssize_t ret = pwrite(spillFd_, data + done, size - done, pos + static_cast<off_t>(done));
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        CHECK_AND_RETURN_RET_LOG(ret > 0, false, "spill the sample table failed, errno %{public}d", errno);
+        done += static_cast<size_t>(ret);
+    }
+    spilledRecords_ += run_.size();
+    run_.clear();
+    nextSpillSamples_ = runSamples_;
+    return true;
+}
+
+bool Mp4SampleTable::OpenSpillFile()
+{
+#ifdef O_TMPFILE
+    spillFd_ = open(spillDir_.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (spillFd_ >= 0) {
+        return true;
+    }
+#endif
+    // the file systems without O_TMPFILE, the name is removed at once so nothing is left behind by a crash.
+    std::string path = spillDir_ + "/mp4_sample_table_XXXXXX";
+    spillFd_ = mkstemp(&path[0]);
+    if (spillFd_ < 0) {
+        AVCODEC_LOGW("create the spill file in %{public}s failed, errno %{public}d, keep the samples in memory",
+            spillDir_.c_str(), errno);
+        return false;
+    }
+    (void)unlink(path.c_str());
+    (void)fcntl(spillFd_, F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+bool Mp4SampleTable::ReadRun(uint64_t first, uint32_t count, std::vector<Record> &records) const
+{
+    records.resize(count);
+    uint8_t *data = reinterpret_cast<uint8_t *>(records.data());
+    size_t size = count * sizeof(Record);
+    off_t pos = static_cast<off_t>(first * sizeof(Record));
+    size_t done = 0;
+    while (done < size) {
+        ssize_t ret = pread(spillFd_, data + done, size - done, pos + static_cast<off_t>(done));
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        CHECK_AND_RETURN_RET_LOG(ret > 0, false, "read the spilled sample table failed, errno %{public}d", errno);
+        done += static_cast<size_t>(ret);
+    }
+    return true;
+}
+
+bool Mp4SampleTable::ForEach(const std::function<bool(const Sample &sample, uint32_t index)> &visitor) const
+{
+    // the duration of a sample is the distance to the next one, so each sample is emitted one step late.
+    bool hasPending = false;
+    Sample pending;
+    uint32_t index = 0;
+    auto visit = [&](const Record &record) {
+        if (hasPending) {
+            pending.duration = record.dts - pending.dts;
+            if (!visitor(pending, index++)) {
+                return false;
+            }
+        }
+        pending.dts = record.dts;
+        pending.offset = record.offset;
+        pending.size = record.size;
+        pending.ctsOffset = record.ctsOffset;
+        pending.sync = record.sync != 0;
+        hasPending = true;
+        return true;
+    };
+    std::vector<Record> records;
+    for (uint64_t first = 0; first < spilledRecords_; first += runSamples_) {
+        uint32_t count = static_cast<uint32_t>(std::min<uint64_t>(runSamples_, spilledRecords_ - first));
+        if (!ReadRun(first, count, records)) {
+            return false;
+        }
+        for (const auto &record : records) {
+            if (!visit(record)) {
+                return false;
+            }
+        }
+    }
+    for (const auto &record : run_) {
+        if (!visit(record)) {
+            return false;
+        }
+    }
+    if (hasPending) {
+        pending.duration = lastDuration_;
+        return visitor(pending, index);
+    }
+    return true;
+}
+
+bool Mp4SampleTable::ForEachChunk(const std::function<bool(uint64_t offset, uint32_t samples)> &visitor) const
+{
+    uint64_t chunkOffset = 0;
+    uint64_t chunkEnd = 0;
+    uint32_t samples = 0;
+    bool ok = ForEach([&](const Sample &sample, uint32_t index) {
+        if (index > 0 && sample.offset == chunkEnd) {
+            samples++;
+        } else {
+            if (samples > 0 && !visitor(chunkOffset, samples)) {
+                return false;
+            }
+            chunkOffset = sample.offset;
+            samples = 1;
+        }
+        chunkEnd = sample.offset + sample.size;
+        return true;
+    });
+    return ok && (samples == 0 || visitor(chunkOffset, samples));
+}
+
+uint64_t Mp4SampleTable::GetMemoryBytes() const
+{
+    return run_.capacity() * sizeof(Record);
+}
+} // Mp4
+} // Plugin
+} // Media
+} // OHOS
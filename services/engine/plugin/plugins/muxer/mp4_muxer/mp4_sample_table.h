@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MP4_SAMPLE_TABLE_H
+#define MP4_SAMPLE_TABLE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace OHOS {
+namespace Media {
+namespace Plugin {
+namespace Mp4 {
+/**
+ * The sample table of one track. The samples are kept in memory in runs of a fixed count, a completed run is
+ * appended to an unnamed temporary file, so the memory of a track stays flat however long the recording is.
+ * The entry counts of the stts, ctts, stss, stsc and stco boxes are tracked while appending, so the size of
+ * the moov is known before the samples are read back, box by box, with ForEach.
+ */
+class Mp4SampleTable {
+public:
+    struct Sample {
+        int64_t dts = 0; // in the timescale of the track
+        int64_t duration = 0; // only filled by ForEach
+        int32_t ctsOffset = 0;
+        uint32_t size = 0;
+        uint64_t offset = 0;
+        bool sync = false;
+    };
+
+    struct Summary {
+        uint32_t sampleCount = 0;
+        uint32_t sttsEntries = 0;
+        uint32_t cttsEntries = 0;
+        uint32_t syncSamples = 0;
+        uint32_t chunkCount = 0;
+        uint32_t stscEntries = 0;
+        bool largeOffsets = false; // co64 instead of stco
+    };
+
+    explicit Mp4SampleTable(std::string spillDir, uint32_t runSamples = DEFAULT_RUN_SAMPLES);
+    ~Mp4SampleTable();
+
+    Mp4SampleTable(const Mp4SampleTable &) = delete;
+    Mp4SampleTable &operator=(const Mp4SampleTable &) = delete;
+
+    bool Append(const Sample &sample);
+    // Sets the duration of the last sample, which has no next sample to take it from.
+    void Finish(int64_t lastDuration);
+    const Summary &GetSummary() const
+    {
+        return summary_;
+    }
+    int64_t GetDuration() const;
+    // Visits the samples in order, stops and returns false when the visitor returns false or the read fails.
+    bool ForEach(const std::function<bool(const Sample &sample, uint32_t index)> &visitor) const;
+    // Visits the chunks in order with the offset and the sample count of each.
+    bool ForEachChunk(const std::function<bool(uint64_t offset, uint32_t samples)> &visitor) const;
+    uint64_t GetMemoryBytes() const;
+    uint64_t GetSpilledBytes() const
+    {
+        return spilledRecords_ * sizeof(Record);
+    }
+
+    static constexpr uint32_t DEFAULT_RUN_SAMPLES = 4096;
+
+private:
+#pragma pack(push, 1)
+    struct Record {
+        int64_t dts;
+        uint64_t offset;
+        uint32_t size;
+        int32_t ctsOffset;
+        uint8_t sync;
+    };
+#pragma pack(pop)
+
+    bool Spill();
+    bool OpenSpillFile();
+    bool ReadRun(uint64_t first, uint32_t count, std::vector<Record> &records) const;
+    void UpdateSummary(const Sample &sample);
+
+    std::string spillDir_;
+    uint32_t runSamples_ = DEFAULT_RUN_SAMPLES;
+    int32_t spillFd_ = -1;
+    uint64_t spilledRecords_ = 0;
+    uint64_t nextSpillSamples_ = DEFAULT_RUN_SAMPLES; // the run size at which the next spill is tried
+    std::vector<Record> run_;
+    Summary summary_;
+
+    bool hasLast_ = false;
+    Sample last_;
+    int64_t firstDts_ = 0;
+    int64_t lastDelta_ = -1;
+    int64_t lastDuration_ = 0;
+    int32_t lastCtsOffset_ = 0;
+    uint32_t chunkSamples_ = 0;
+    uint32_t lastChunkSamples_ = 0;
+};
+} // Mp4
+} // Plugin
+} // Media
+} // OHOS
+#endif // MP4_SAMPLE_TABLE_H
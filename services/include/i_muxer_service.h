@@ -21,6 +21,7 @@
 #include "avsharedmemory.h"
 #include "media_description.h"
 #include "av_common.h"
+#include "avmuxer.h"
 
 namespace OHOS {
 namespace Media {
@@ -31,10 +32,13 @@ public:
     virtual int32_t InitParameter(int32_t fd, OutputFormat format) = 0;
     virtual int32_t SetLocation(float latitude, float longitude) = 0;
     virtual int32_t SetRotation(int32_t rotation) = 0;
+    virtual int32_t SetParameter(const MediaDescription &param) = 0;
+    virtual int32_t SetCallback(const std::shared_ptr<AVMuxerCallback> &callback) = 0;
     virtual int32_t AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc) = 0;
     virtual int32_t Start() = 0;
     virtual int32_t WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info) = 0;
     virtual int32_t Stop() = 0;
+    virtual int32_t SetNextOutputFile(int32_t fd) = 0;
     virtual void Release() = 0;
 };
 } // namespace Media
@@ -14,6 +14,7 @@
  */
 
 #include "avsharedmemory_ipc.h"
+#include <cinttypes>
 #include <unistd.h>
 #include "avsharedmemorybase.h"
 #include "avdatasrcmemory.h"
@@ -62,6 +63,87 @@ std::shared_ptr<AVSharedMemory> ReadAVSharedMemoryFromParcel(MessageParcel &parc
     return memory;
 }
 
+int32_t AVSharedMemoryRegistry::WriteToParcel(const std::shared_ptr<AVSharedMemory> &memory, MessageParcel &parcel)
+{
+    std::shared_ptr<AVSharedMemoryBase> baseMem = std::static_pointer_cast<AVSharedMemoryBase>(memory);
+    CHECK_AND_RETURN_RET_LOG(baseMem != nullptr, AVCS_ERR_INVALID_VAL, "invalid pointer");
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto iter = registered_.begin(); iter != registered_.end();) {
+        if (iter->second.expired()) {
+            released_.push_back(iter->first);
+            iter = registered_.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    uint64_t id = baseMem->GetUniqueId();
+    bool isNew = registered_.find(id) == registered_.end();
+    CHECK_AND_RETURN_RET_LOG(parcel.WriteUInt64Vector(released_), AVCS_ERR_UNKNOWN, "write released ids failed");
+    lastReleased_ = std::move(released_);
+    released_.clear();
+    CHECK_AND_RETURN_RET_LOG(parcel.WriteUint64(id), AVCS_ERR_UNKNOWN, "write memory id failed");
+    CHECK_AND_RETURN_RET_LOG(parcel.WriteBool(isNew), AVCS_ERR_UNKNOWN, "write memory registration failed");
+    if (!isNew) {
+        return AVCS_ERR_OK;
+    }
+
+    int32_t ret = WriteAVSharedMemoryToParcel(memory, parcel);
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "write memory to parcel failed");
+    registered_[id] = baseMem->GetAliveToken();
+    return AVCS_ERR_OK;
+}
+
+void AVSharedMemoryRegistry::Reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // the remote side may hold any of the registered memories and the ones released by the lost write, they are
+    // reported as released next time. a memory written again with its fd is mapped after the report is handled.
+    released_.insert(released_.end(), lastReleased_.begin(), lastReleased_.end());
+    lastReleased_.clear();
+    for (const auto &memory : registered_) {
+        released_.push_back(memory.first);
+    }
+    registered_.clear();
+}
+
+std::shared_ptr<AVSharedMemory> AVSharedMemoryCache::ReadFromParcel(MessageParcel &parcel)
+{
+    std::vector<uint64_t> releasedIds;
+    CHECK_AND_RETURN_RET_LOG(parcel.ReadUInt64Vector(&releasedIds), nullptr, "read released ids failed");
+    uint64_t id = parcel.ReadUint64();
+    bool isNew = parcel.ReadBool();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto releasedId : releasedIds) {
+        (void)memories_.erase(releasedId);
+    }
+
+    if (isNew) {
+        std::shared_ptr<AVSharedMemory> memory = ReadAVSharedMemoryFromParcel(parcel);
+        CHECK_AND_RETURN_RET_LOG(memory != nullptr, nullptr, "read memory %{public}" PRIu64 " failed", id);
+        memories_[id] = memory;
+        return memory;
+    }
+
+    auto iter = memories_.find(id);
+    CHECK_AND_RETURN_RET_LOG(iter != memories_.end(), nullptr, "memory %{public}" PRIu64 " is not registered", id);
+    return iter->second;
+}
+
+void AVSharedMemoryCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    memories_.clear();
+}
+
+size_t AVSharedMemoryCache::Size()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return memories_.size();
+}
+
 std::shared_ptr<AVSharedMemory> ReadADataSrcMemoryFromParcel(MessageParcel &parcel)
 {
     int32_t fd  = parcel.ReadFileDescriptor();
@@ -16,7 +16,11 @@
 #ifndef AVSHAREDMEMORY_IPC_H
 #define AVSHAREDMEMORY_IPC_H
 
+#include <map>
+#include <mutex>
+#include <vector>
 #include <message_parcel.h>
+#include "nocopyable.h"
 #include "avsharedmemory.h"
 
 namespace OHOS {
@@ -25,6 +29,44 @@ namespace Media {
     MessageParcel &parcel);
 [[maybe_unused]] std::shared_ptr<AVSharedMemory> ReadAVSharedMemoryFromParcel(MessageParcel &parcel);
 [[maybe_unused]] std::shared_ptr<AVSharedMemory> ReadADataSrcMemoryFromParcel(MessageParcel &parcel);
+
+/**
+ * @brief Sender side registry of the memories passed to one remote object. The fd of a memory is only
+ * written the first time it is seen, afterwards just its id is written. The ids of the registered memories
+ * destroyed since the last write are piggybacked, so that the remote side can drop its mappings. Reset() is
+ * called when a write did not reach the remote side, the memories are written again with their fd then, and
+ * the ids it may still hold are reported with the next write.
+ */
+class AVSharedMemoryRegistry : public NoCopyable {
+public:
+    AVSharedMemoryRegistry() = default;
+    ~AVSharedMemoryRegistry() = default;
+    int32_t WriteToParcel(const std::shared_ptr<AVSharedMemory> &memory, MessageParcel &parcel);
+    void Reset();
+
+private:
+    std::mutex mutex_;
+    std::map<uint64_t, std::weak_ptr<const uint64_t>> registered_;
+    std::vector<uint64_t> released_; // to be reported with the next write
+    std::vector<uint64_t> lastReleased_; // reported with the last write, it may not have arrived
+};
+
+/**
+ * @brief Receiver side cache of the mappings of the memories written by an AVSharedMemoryRegistry, so that
+ * a memory sent repeatedly is mapped once instead of per request.
+ */
+class AVSharedMemoryCache : public NoCopyable {
+public:
+    AVSharedMemoryCache() = default;
+    ~AVSharedMemoryCache() = default;
+    std::shared_ptr<AVSharedMemory> ReadFromParcel(MessageParcel &parcel);
+    void Clear();
+    size_t Size();
+
+private:
+    std::mutex mutex_;
+    std::map<uint64_t, std::shared_ptr<AVSharedMemory>> memories_;
+};
 } // namespace Media
 } // namespace OHOS
 #endif
@@ -14,11 +14,17 @@
  */
 
 #include "muxer_client.h"
+#include <pthread.h>
+#include "securec.h"
 #include "avcodec_errors.h"
 #include "avcodec_log.h"
 
 namespace {
     constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "MuxerClient"};
+    constexpr int32_t BATCH_BUFFER_SIZE = 256 * 1024;
+    constexpr uint32_t BATCH_BUFFER_MAX_CNT = 4;
+    constexpr uint32_t MAX_BATCHED_SAMPLE_SIZE = 16 * 1024;
+    constexpr size_t MAX_BATCH_SAMPLE_COUNT = 64;
 }
 
 namespace OHOS {
@@ -37,7 +43,12 @@ MuxerClient::MuxerClient(const sptr<IStandardMuxerService> &ipcProxy)
 
 MuxerClient::~MuxerClient()
 {
+    StopFlushThread();
     std::lock_guard<std::mutex> lock(mutex_);
+    if (listenerStub_ != nullptr) {
+        listenerStub_->SetBuffersReleasedNotifier(nullptr);
+        listenerStub_->SetCallback(nullptr);
+    }
     if (muxerProxy_ != nullptr) {
         (void)muxerProxy_->DestroyStub();
         muxerProxy_ = nullptr;
@@ -49,6 +60,41 @@ void MuxerClient::AVCodecServerDied()
 {
     std::lock_guard<std::mutex> lock(mutex_);
     muxerProxy_ = nullptr;
+    ResetBatch();
+    inFlightBuffers_.clear();
+}
+
+int32_t MuxerClient::InitListener()
+{
+    if (listenerStub_ != nullptr) {
+        return AVCS_ERR_OK;
+    }
+    sptr<MuxerListenerStub> listenerStub = new(std::nothrow) MuxerListenerStub();
+    CHECK_AND_RETURN_RET_LOG(listenerStub != nullptr, AVCS_ERR_NO_MEMORY, "failed to new MuxerListenerStub");
+    std::weak_ptr<MuxerClient> weakClient = weak_from_this();
+    listenerStub->SetBuffersReleasedNotifier([weakClient](const std::vector<uint32_t> &releasedBufferIds) {
+        std::shared_ptr<MuxerClient> client = weakClient.lock();
+        if (client != nullptr) {
+            client->OnBuffersReleased(releasedBufferIds);
+        }
+    });
+    int32_t ret = muxerProxy_->SetListenerObject(listenerStub->AsObject());
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Set listener object failed");
+    listenerStub_ = listenerStub;
+    return AVCS_ERR_OK;
+}
+
+void MuxerClient::OnBuffersReleased(const std::vector<uint32_t> &releasedBufferIds)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    RecycleBuffers(releasedBufferIds);
+}
+
+void MuxerClient::RecycleBuffers(const std::vector<uint32_t> &releasedBufferIds)
+{
+    for (auto bufferId : releasedBufferIds) {
+        (void)inFlightBuffers_.erase(bufferId);
+    }
 }
 
 int32_t MuxerClient::InitParameter(int32_t fd, OutputFormat format)
@@ -72,6 +118,51 @@ int32_t MuxerClient::SetRotation(int32_t rotation)
     return muxerProxy_->SetRotation(rotation);
 }
 
+int32_t MuxerClient::SetParameter(const MediaDescription &param)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK_AND_RETURN_RET_LOG(muxerProxy_ != nullptr, AVCS_ERR_NO_MEMORY, "Muxer Service does not exist");
+    MediaDescription serviceParam = param;
+    int64_t batchLatencyUs = 0;
+    if (serviceParam.GetLongValue(MediaDescriptionKey::MD_KEY_MUXER_BATCH_LATENCY, batchLatencyUs)) {
+        CHECK_AND_RETURN_RET_LOG(batchLatencyUs >= 0, AVCS_ERR_INVALID_VAL,
+            "Invalid batch latency %{public}" PRId64, batchLatencyUs);
+        int32_t ret = FlushBatch();
+        CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Flush batched samples failed");
+        batchLatencyUs_ = batchLatencyUs;
+        serviceParam.RemoveKey(MediaDescriptionKey::MD_KEY_MUXER_BATCH_LATENCY);
+    }
+    int32_t asyncWrite = 0;
+    if (serviceParam.GetIntValue(MediaDescriptionKey::MD_KEY_MUXER_ASYNC_WRITE, asyncWrite)) {
+        // the results and the released buffers of one-way requests can only come back through the listener.
+        int32_t ret = asyncWrite != 0 ? InitListener() : AVCS_ERR_OK;
+        CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Init listener failed");
+        asyncWrite_ = asyncWrite != 0;
+        serviceParam.RemoveKey(MediaDescriptionKey::MD_KEY_MUXER_ASYNC_WRITE);
+    }
+    int32_t nonBlocking = 0;
+    if (serviceParam.GetIntValue(MediaDescriptionKey::MD_KEY_MUXER_NON_BLOCKING, nonBlocking)) {
+        // the key is also handled by the service, so it is kept in serviceParam.
+        int32_t ret = FlushBatch();
+        CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Flush batched samples failed");
+        nonBlocking_ = nonBlocking != 0;
+    }
+    if (serviceParam.GetFormatMap().empty()) {
+        return AVCS_ERR_OK;
+    }
+    return muxerProxy_->SetParameter(serviceParam);
+}
+
+int32_t MuxerClient::SetCallback(const std::shared_ptr<AVMuxerCallback> &callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK_AND_RETURN_RET_LOG(muxerProxy_ != nullptr, AVCS_ERR_NO_MEMORY, "Muxer Service does not exist");
+    int32_t ret = InitListener();
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Init listener failed");
+    listenerStub_->SetCallback(callback);
+    return AVCS_ERR_OK;
+}
+
 int32_t MuxerClient::AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc)
 {
     std::lock_guard<std::mutex> lock(mutex_);
@@ -91,21 +182,185 @@ int32_t MuxerClient::WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuf
     std::lock_guard<std::mutex> lock(mutex_);
     CHECK_AND_RETURN_RET_LOG(sampleBuffer != nullptr, AVCS_ERR_INVALID_VAL, "sampleBuffer is nullptr");
     CHECK_AND_RETURN_RET_LOG(muxerProxy_ != nullptr, AVCS_ERR_NO_MEMORY, "Muxer Service does not exist");
-    return muxerProxy_->WriteSampleBuffer(sampleBuffer, info);
+
+    if (nonBlocking_) {
+        // a rejected sample must be reported to the caller of this very call, so it can not be batched
+        // or sent one-way.
+        return WriteSampleBufferDirectly(sampleBuffer, info);
+    }
+    if (batchLatencyUs_ > 0 && info.size <= MAX_BATCHED_SAMPLE_SIZE) {
+        return AppendToBatch(sampleBuffer, info);
+    }
+    // keep the samples in submission order, the batched ones go first.
+    int32_t ret = FlushBatch();
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Flush batched samples failed");
+    return WriteSampleBufferDirectly(sampleBuffer, info);
+}
+
+int32_t MuxerClient::WriteSampleBufferDirectly(std::shared_ptr<AVSharedMemory> sampleBuffer,
+    const TrackSampleInfo &info)
+{
+    // hold the memory until the service reports it has been written, so that a pooled buffer is never
+    // handed out again while the service may still read it.
+    uint32_t bufferId = nextBufferId_++;
+    inFlightBuffers_[bufferId] = sampleBuffer;
+    std::vector<uint32_t> releasedBufferIds;
+    bool async = asyncWrite_ && !nonBlocking_;
+    int32_t ret = muxerProxy_->WriteSampleBuffer(sampleBuffer, info, bufferId, async, releasedBufferIds);
+    RecycleBuffers(releasedBufferIds);
+    return ret;
+}
+
+int32_t MuxerClient::AppendToBatch(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info)
+{
+    if (batchBuffer_ != nullptr && batchUsedSize_ + info.size > static_cast<uint32_t>(batchBuffer_->GetSize())) {
+        int32_t ret = FlushBatch();
+        CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Flush batched samples failed");
+    }
+
+    if (batchBuffer_ == nullptr) {
+        if (batchPool_ == nullptr) {
+            batchPool_ = std::make_shared<AVSharedMemoryPool>("muxerBatchBuffer");
+            AVSharedMemoryPool::InitializeOption option = {
+                .preAllocMemCnt = 1,
+                .memSize = BATCH_BUFFER_SIZE,
+                .maxMemCnt = BATCH_BUFFER_MAX_CNT,
+                .flags = AVSharedMemory::FLAGS_READ_ONLY,
+            };
+            int32_t ret = batchPool_->Init(option);
+            if (ret != AVCS_ERR_OK) {
+                batchPool_ = nullptr;
+                AVCODEC_LOGE("Init batch buffer pool failed, ret %{public}d", ret);
+                return WriteSampleBufferDirectly(sampleBuffer, info);
+            }
+        }
+        batchBuffer_ = batchPool_->AcquireMemory(-1, false);
+        if (batchBuffer_ == nullptr) {
+            // all batch buffers are still held by the service, do not wait for them.
+            return WriteSampleBufferDirectly(sampleBuffer, info);
+        }
+        batchStartTime_ = std::chrono::steady_clock::now();
+        StartFlushThread();
+        flushCond_.notify_one();
+    }
+
+    errno_t rc = memcpy_s(batchBuffer_->GetBase() + batchUsedSize_, batchBuffer_->GetSize() - batchUsedSize_,
+        sampleBuffer->GetBase(), info.size);
+    CHECK_AND_RETURN_RET_LOG(rc == EOK, AVCS_ERR_UNKNOWN, "memcpy_s failed");
+    batchInfos_.push_back(info);
+    batchOffsets_.push_back(batchUsedSize_);
+    batchUsedSize_ += info.size;
+
+    int64_t waitedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - batchStartTime_).count();
+    if (batchInfos_.size() >= MAX_BATCH_SAMPLE_COUNT || waitedUs >= batchLatencyUs_) {
+        return FlushBatch();
+    }
+    return AVCS_ERR_OK;
+}
+
+int32_t MuxerClient::FlushBatch()
+{
+    if (batchInfos_.empty()) {
+        return AVCS_ERR_OK;
+    }
+    uint32_t bufferId = nextBufferId_++;
+    inFlightBuffers_[bufferId] = batchBuffer_;
+    std::vector<uint32_t> releasedBufferIds;
+    int32_t ret = muxerProxy_->WriteSampleBuffers(batchBuffer_, batchInfos_, batchOffsets_, bufferId, asyncWrite_,
+        releasedBufferIds);
+    RecycleBuffers(releasedBufferIds);
+    ResetBatch();
+    return ret;
+}
+
+void MuxerClient::StartFlushThread()
+{
+    if (flushThread_ != nullptr) {
+        return;
+    }
+    flushStopping_ = false;
+    flushThread_ = std::make_unique<std::thread>(&MuxerClient::FlushProcessor, this);
+}
+
+void MuxerClient::StopFlushThread()
+{
+    std::unique_ptr<std::thread> t;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flushStopping_ = true;
+        t = std::move(flushThread_);
+    }
+    flushCond_.notify_all();
+    if (t != nullptr && t->joinable()) {
+        t->join();
+    }
+}
+
+void MuxerClient::FlushProcessor()
+{
+    pthread_setname_np(pthread_self(), "muxer_batch");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!flushStopping_) {
+        if (batchInfos_.empty()) {
+            flushCond_.wait(lock, [this] { return flushStopping_ || !batchInfos_.empty(); });
+            continue;
+        }
+        // a batch that is not followed by another sample must still reach the service within its latency.
+        auto deadline = batchStartTime_ + std::chrono::microseconds(batchLatencyUs_);
+        if (flushCond_.wait_until(lock, deadline) != std::cv_status::timeout || batchInfos_.empty()) {
+            continue;
+        }
+        if (std::chrono::steady_clock::now() < batchStartTime_ + std::chrono::microseconds(batchLatencyUs_)) {
+            continue;
+        }
+        if (muxerProxy_ == nullptr) {
+            ResetBatch();
+            continue;
+        }
+        int32_t ret = FlushBatch();
+        if (ret != AVCS_ERR_OK) {
+            AVCODEC_LOGE("Flush the expired batch failed, ret %{public}d", ret);
+        }
+    }
+}
+
+void MuxerClient::ResetBatch()
+{
+    batchBuffer_ = nullptr;
+    batchInfos_.clear();
+    batchOffsets_.clear();
+    batchUsedSize_ = 0;
 }
 
 int32_t MuxerClient::Stop()
 {
     std::lock_guard<std::mutex> lock(mutex_);
     CHECK_AND_RETURN_RET_LOG(muxerProxy_ != nullptr, AVCS_ERR_NO_MEMORY, "Muxer Service does not exist");
-    return muxerProxy_->Stop();
+    int32_t flushRet = FlushBatch();
+    int32_t ret = muxerProxy_->Stop();
+    inFlightBuffers_.clear();
+    return flushRet != AVCS_ERR_OK ? flushRet : ret;
+}
+
+int32_t MuxerClient::SetNextOutputFile(int32_t fd)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK_AND_RETURN_RET_LOG(muxerProxy_ != nullptr, AVCS_ERR_NO_MEMORY, "Muxer Service does not exist");
+    // the switch applies to the samples written after this call, so the batched ones go first.
+    int32_t ret = FlushBatch();
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Flush the batched samples failed");
+    return muxerProxy_->SetNextOutputFile(fd);
 }
 
 void MuxerClient::Release()
 {
+    StopFlushThread();
     std::lock_guard<std::mutex> lock(mutex_);
     CHECK_AND_RETURN_LOG(muxerProxy_ != nullptr, "Muxer Service does not exist");
+    ResetBatch();
     muxerProxy_->Release();
+    inFlightBuffers_.clear();
 }
 }  // namespace Media
 }  // namespace OHOS
\ No newline at end of file
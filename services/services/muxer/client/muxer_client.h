@@ -16,13 +16,20 @@
 #ifndef MUXER_CLIENT_H
 #define MUXER_CLIENT_H
 
+#include <chrono>
+#include <condition_variable>
+#include <map>
 #include <mutex>
+#include <thread>
+#include <vector>
 #include "i_muxer_service.h"
 #include "i_standard_muxer_service.h"
+#include "muxer_listener_stub.h"
+#include "avsharedmemorypool.h"
 
 namespace OHOS {
 namespace Media {
-class MuxerClient : public IMuxerService, public NoCopyable {
+class MuxerClient : public IMuxerService, public std::enable_shared_from_this<MuxerClient>, public NoCopyable {
 public:
     static std::shared_ptr<MuxerClient> Create(const sptr<IStandardMuxerService> &ipcProxy);
     explicit MuxerClient(const sptr<IStandardMuxerService> &ipcProxy);
@@ -31,16 +38,45 @@ public:
     int32_t InitParameter(int32_t fd, OutputFormat format) override;
     int32_t SetLocation(float latitude, float longitude) override;
     int32_t SetRotation(int32_t rotation) override;
+    int32_t SetParameter(const MediaDescription &param) override;
+    int32_t SetCallback(const std::shared_ptr<AVMuxerCallback> &callback) override;
     int32_t AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc) override;
     int32_t Start() override;
     int32_t WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info) override;
     int32_t Stop() override;
+    int32_t SetNextOutputFile(int32_t fd) override;
     void Release() override;
 
     void AVCodecServerDied();
 private:
+    int32_t InitListener();
+    void OnBuffersReleased(const std::vector<uint32_t> &releasedBufferIds);
+    void RecycleBuffers(const std::vector<uint32_t> &releasedBufferIds);
+    int32_t WriteSampleBufferDirectly(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info);
+    int32_t AppendToBatch(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info);
+    int32_t FlushBatch();
+    void ResetBatch();
+    void StartFlushThread();
+    void StopFlushThread();
+    void FlushProcessor();
+
     std::mutex mutex_;
     sptr<IStandardMuxerService> muxerProxy_ = nullptr;
+    sptr<MuxerListenerStub> listenerStub_ = nullptr;
+    bool asyncWrite_ = false;
+    bool nonBlocking_ = false;
+    std::map<uint32_t, std::shared_ptr<AVSharedMemory>> inFlightBuffers_;
+    uint32_t nextBufferId_ = 0;
+    int64_t batchLatencyUs_ = 0;
+    std::shared_ptr<AVSharedMemoryPool> batchPool_ = nullptr;
+    std::shared_ptr<AVSharedMemory> batchBuffer_ = nullptr;
+    std::vector<TrackSampleInfo> batchInfos_;
+    std::vector<uint32_t> batchOffsets_;
+    uint32_t batchUsedSize_ = 0;
+    std::chrono::steady_clock::time_point batchStartTime_;
+    std::unique_ptr<std::thread> flushThread_ = nullptr;
+    std::condition_variable flushCond_;
+    bool flushStopping_ = false;
 };
 }  // namespace Media
 }  // namespace OHOS
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef I_STANDARD_MUXER_LISTENER_H
+#define I_STANDARD_MUXER_LISTENER_H
+
+#include <vector>
+#include "ipc_types.h"
+#include "iremote_broker.h"
+#include "iremote_proxy.h"
+#include "iremote_stub.h"
+
+namespace OHOS {
+namespace Media {
+class IStandardMuxerListener : public IRemoteBroker {
+public:
+    virtual ~IStandardMuxerListener() = default;
+    virtual void OnError(int32_t errorCode) = 0;
+    /**
+     * @brief Notify the ids of the sample memories that the service has finished with, it is only used when
+     * the samples are submitted asynchronously and the ids can not be returned by the reply.
+     */
+    virtual void OnBuffersReleased(const std::vector<uint32_t> &bufferIds) = 0;
+    virtual void OnSpaceAvailable() = 0;
+    virtual void OnOutputFileSwitched(int64_t startTimeUs) = 0;
+
+    enum MuxerListenerMsg {
+        ON_ERROR = 0,
+        ON_BUFFERS_RELEASED,
+        ON_SPACE_AVAILABLE,
+        ON_OUTPUT_FILE_SWITCHED,
+    };
+
+    DECLARE_INTERFACE_DESCRIPTOR(u"IStandardMuxerListener");
+};
+} // namespace Media
+} // namespace OHOS
+#endif // I_STANDARD_MUXER_LISTENER_H
@@ -18,6 +18,7 @@
 
 #include "i_muxer_service.h"
 #include "iremote_proxy.h"
+#include "ipc_types.h"
 
 namespace OHOS {
 namespace Media {
@@ -27,10 +28,29 @@ public:
     virtual int32_t InitParameter(int32_t fd, OutputFormat format) = 0;
     virtual int32_t SetLocation(float latitude, float longitude) = 0;
     virtual int32_t SetRotation(int32_t rotation) = 0;
+    virtual int32_t SetParameter(const MediaDescription &param) = 0;
+    virtual int32_t SetListenerObject(const sptr<IRemoteObject> &object) = 0;
     virtual int32_t AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc) = 0;
     virtual int32_t Start() = 0;
-    virtual int32_t WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info) = 0;
+    /**
+     * @brief Write a sample held in a client owned shared memory. The service keeps its mapping of the memory
+     * until the sample is written to the file, and the ids of the memories it has finished with since the last
+     * call are returned through releasedBufferIds so that the client can recycle them.
+     * If async is true the request is one-way, the result and the released ids are reported through the
+     * listener instead. A request that does not reach the service returns its own bufferId as released.
+     */
+    virtual int32_t WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info,
+        uint32_t bufferId, bool async, std::vector<uint32_t> &releasedBufferIds) = 0;
+    /**
+     * @brief Write several samples packed in one shared memory within one transaction, the sample i is
+     * stored at offsets[i] with infos[i].size bytes. The memory is released as a whole once all samples
+     * are written.
+     */
+    virtual int32_t WriteSampleBuffers(std::shared_ptr<AVSharedMemory> sampleBuffers,
+        const std::vector<TrackSampleInfo> &infos, const std::vector<uint32_t> &offsets,
+        uint32_t bufferId, bool async, std::vector<uint32_t> &releasedBufferIds) = 0;
     virtual int32_t Stop() = 0;
+    virtual int32_t SetNextOutputFile(int32_t fd) = 0;
     virtual void Release() = 0;
     virtual int32_t DestroyStub() = 0;
 
@@ -43,7 +63,11 @@ public:
         WRITE_SAMPLE_BUFFER,
         STOP,
         RELEASE,
-		DESTROY,
+        DESTROY,
+        SET_PARAMETER,
+        WRITE_SAMPLE_BUFFERS,
+        SET_LISTENER_OBJ,
+        SET_NEXT_OUTPUT_FILE,
     };
     
     DECLARE_INTERFACE_DESCRIPTOR(u"IStandardMuxerServiceq1a");
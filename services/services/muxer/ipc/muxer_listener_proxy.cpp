@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "muxer_listener_proxy.h"
+#include "avcodec_log.h"
+#include "avcodec_errors.h"
+
+namespace {
+    constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "MuxerListenerProxy"};
+}
+
+namespace OHOS {
+namespace Media {
+MuxerListenerProxy::MuxerListenerProxy(const sptr<IRemoteObject> &impl)
+    : IRemoteProxy<IStandardMuxerListener>(impl)
+{
+    AVCODEC_LOGD("0x%{public}06" PRIXPTR " Instances create", FAKE_POINTER(this));
+}
+
+MuxerListenerProxy::~MuxerListenerProxy()
+{
+    AVCODEC_LOGD("0x%{public}06" PRIXPTR " Instances destroy", FAKE_POINTER(this));
+}
+
+void MuxerListenerProxy::OnError(int32_t errorCode)
+{
+    MessageParcel data;
+    MessageParcel reply;
+    MessageOption option(MessageOption::TF_ASYNC);
+
+    bool token = data.WriteInterfaceToken(MuxerListenerProxy::GetDescriptor());
+    CHECK_AND_RETURN_LOG(token, "Write descriptor failed!");
+
+    (void)data.WriteInt32(errorCode);
+    int error = Remote()->SendRequest(ON_ERROR, data, reply, option);
+    CHECK_AND_RETURN_LOG(error == AVCS_ERR_OK, "Send OnError failed, error: %{public}d", error);
+}
+
+void MuxerListenerProxy::OnBuffersReleased(const std::vector<uint32_t> &bufferIds)
+{
+    MessageParcel data;
+    MessageParcel reply;
+    MessageOption option(MessageOption::TF_ASYNC);
+
+    bool token = data.WriteInterfaceToken(MuxerListenerProxy::GetDescriptor());
+    CHECK_AND_RETURN_LOG(token, "Write descriptor failed!");
+
+    CHECK_AND_RETURN_LOG(data.WriteUInt32Vector(bufferIds), "Write released buffer ids failed!");
+    int error = Remote()->SendRequest(ON_BUFFERS_RELEASED, data, reply, option);
+    CHECK_AND_RETURN_LOG(error == AVCS_ERR_OK, "Send OnBuffersReleased failed, error: %{public}d", error);
+}
+
+void MuxerListenerProxy::OnSpaceAvailable()
+{
+    MessageParcel data;
+    MessageParcel reply;
+    MessageOption option(MessageOption::TF_ASYNC);
+
+    bool token = data.WriteInterfaceToken(MuxerListenerProxy::GetDescriptor());
+    CHECK_AND_RETURN_LOG(token, "Write descriptor failed!");
+
+    int error = Remote()->SendRequest(ON_SPACE_AVAILABLE, data, reply, option);
+    CHECK_AND_RETURN_LOG(error == AVCS_ERR_OK, "Send OnSpaceAvailable failed, error: %{public}d", error);
+}
+
+void MuxerListenerProxy::OnOutputFileSwitched(int64_t startTimeUs)
+{
+    MessageParcel data;
+    MessageParcel reply;
+    MessageOption option(MessageOption::TF_ASYNC);
+
+    bool token = data.WriteInterfaceToken(MuxerListenerProxy::GetDescriptor());
+    CHECK_AND_RETURN_LOG(token, "Write descriptor failed!");
+
+    (void)data.WriteInt64(startTimeUs);
+    int error = Remote()->SendRequest(ON_OUTPUT_FILE_SWITCHED, data, reply, option);
+    CHECK_AND_RETURN_LOG(error == AVCS_ERR_OK, "Send OnOutputFileSwitched failed, error: %{public}d", error);
+}
+
+MuxerListenerCallback::MuxerListenerCallback(const sptr<IStandardMuxerListener> &listener) : listener_(listener)
+{
+    AVCODEC_LOGD("0x%{public}06" PRIXPTR " Instances create", FAKE_POINTER(this));
+}
+
+MuxerListenerCallback::~MuxerListenerCallback()
+{
+    AVCODEC_LOGD("0x%{public}06" PRIXPTR " Instances destroy", FAKE_POINTER(this));
+}
+
+void MuxerListenerCallback::OnError(int32_t errorCode)
+{
+    if (listener_ != nullptr) {
+        listener_->OnError(errorCode);
+    }
+}
+
+void MuxerListenerCallback::OnSpaceAvailable()
+{
+    if (listener_ != nullptr) {
+        listener_->OnSpaceAvailable();
+    }
+}
+
+void MuxerListenerCallback::OnOutputFileSwitched(int64_t startTimeUs)
+{
+    if (listener_ != nullptr) {
+        listener_->OnOutputFileSwitched(startTimeUs);
+    }
+}
+} // namespace Media
+} // namespace OHOS
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MUXER_LISTENER_PROXY_H
+#define MUXER_LISTENER_PROXY_H
+
+#include "i_standard_muxer_listener.h"
+#include "avmuxer.h"
+#include "nocopyable.h"
+
+namespace OHOS {
+namespace Media {
+class MuxerListenerProxy : public IRemoteProxy<IStandardMuxerListener>, public NoCopyable {
+public:
+    explicit MuxerListenerProxy(const sptr<IRemoteObject> &impl);
+    virtual ~MuxerListenerProxy();
+    void OnError(int32_t errorCode) override;
+    void OnBuffersReleased(const std::vector<uint32_t> &bufferIds) override;
+    void OnSpaceAvailable() override;
+    void OnOutputFileSwitched(int64_t startTimeUs) override;
+
+private:
+    static inline BrokerDelegator<MuxerListenerProxy> delegator_;
+};
+
+class MuxerListenerCallback : public AVMuxerCallback, public NoCopyable {
+public:
+    explicit MuxerListenerCallback(const sptr<IStandardMuxerListener> &listener);
+    virtual ~MuxerListenerCallback();
+    void OnError(int32_t errorCode) override;
+    void OnSpaceAvailable() override;
+    void OnOutputFileSwitched(int64_t startTimeUs) override;
+
+private:
+    sptr<IStandardMuxerListener> listener_ = nullptr;
+};
+} // namespace Media
+} // namespace OHOS
+#endif // MUXER_LISTENER_PROXY_H
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "muxer_listener_stub.h"
+#include "avcodec_log.h"
+#include "avcodec_errors.h"
+
+namespace {
+    constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "MuxerListenerStub"};
+}
+
+namespace OHOS {
+namespace Media {
+MuxerListenerStub::MuxerListenerStub()
+{
+    AVCODEC_LOGD("0x%{public}06" PRIXPTR " Instances create", FAKE_POINTER(this));
+}
+
+MuxerListenerStub::~MuxerListenerStub()
+{
+    AVCODEC_LOGD("0x%{public}06" PRIXPTR " Instances destroy", FAKE_POINTER(this));
+}
+
+int MuxerListenerStub::OnRemoteRequest(uint32_t code, MessageParcel &data, MessageParcel &reply,
+    MessageOption &option)
+{
+    auto remoteDescriptor = data.ReadInterfaceToken();
+    if (MuxerListenerStub::GetDescriptor() != remoteDescriptor) {
+        AVCODEC_LOGE("Invalid descriptor");
+        return AVCS_ERR_INVALID_OPERATION;
+    }
+
+    switch (code) {
+        case IStandardMuxerListener::ON_ERROR: {
+            OnError(data.ReadInt32());
+            return AVCS_ERR_OK;
+        }
+        case IStandardMuxerListener::ON_BUFFERS_RELEASED: {
+            std::vector<uint32_t> bufferIds;
+            CHECK_AND_RETURN_RET_LOG(data.ReadUInt32Vector(&bufferIds), AVCS_ERR_UNKNOWN,
+                "Read released buffer ids failed!");
+            OnBuffersReleased(bufferIds);
+            return AVCS_ERR_OK;
+        }
+        case IStandardMuxerListener::ON_SPACE_AVAILABLE: {
+            OnSpaceAvailable();
+            return AVCS_ERR_OK;
+        }
+        case IStandardMuxerListener::ON_OUTPUT_FILE_SWITCHED: {
+            OnOutputFileSwitched(data.ReadInt64());
+            return AVCS_ERR_OK;
+        }
+        default: {
+            AVCODEC_LOGW("Failed to find corresponding function");
+            return IPCObjectStub::OnRemoteRequest(code, data, reply, option);
+        }
+    }
+}
+
+void MuxerListenerStub::OnError(int32_t errorCode)
+{
+    std::shared_ptr<AVMuxerCallback> callback = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callback = callback_;
+    }
+    AVCODEC_LOGE("Muxer error: %{public}d", errorCode);
+    if (callback != nullptr) {
+        callback->OnError(errorCode);
+    }
+}
+
+void MuxerListenerStub::OnBuffersReleased(const std::vector<uint32_t> &bufferIds)
+{
+    BuffersReleasedNotifier notifier = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        notifier = notifier_;
+    }
+    if (notifier != nullptr) {
+        notifier(bufferIds);
+    }
+}
+
+void MuxerListenerStub::OnSpaceAvailable()
+{
+    std::shared_ptr<AVMuxerCallback> callback = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callback = callback_;
+    }
+    if (callback != nullptr) {
+        callback->OnSpaceAvailable();
+    }
+}
+
+void MuxerListenerStub::OnOutputFileSwitched(int64_t startTimeUs)
+{
+    std::shared_ptr<AVMuxerCallback> callback = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callback = callback_;
+    }
+    AVCODEC_LOGI("Output file switched at %{public}" PRId64 " us", startTimeUs);
+    if (callback != nullptr) {
+        callback->OnOutputFileSwitched(startTimeUs);
+    }
+}
+
+void MuxerListenerStub::SetCallback(const std::shared_ptr<AVMuxerCallback> &callback)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    callback_ = callback;
+}
+
+void MuxerListenerStub::SetBuffersReleasedNotifier(const BuffersReleasedNotifier &notifier)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    notifier_ = notifier;
+}
+} // namespace Media
+} // namespace OHOS
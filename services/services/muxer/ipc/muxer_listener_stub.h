@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MUXER_LISTENER_STUB_H
+#define MUXER_LISTENER_STUB_H
+
+#include <functional>
+#include <mutex>
+#include "i_standard_muxer_listener.h"
+#include "avmuxer.h"
+#include "nocopyable.h"
+
+namespace OHOS {
+namespace Media {
+class MuxerListenerStub : public IRemoteStub<IStandardMuxerListener>, public NoCopyable {
+public:
+    using BuffersReleasedNotifier = std::function<void(const std::vector<uint32_t> &)>;
+
+    MuxerListenerStub();
+    virtual ~MuxerListenerStub();
+    int OnRemoteRequest(uint32_t code, MessageParcel &data, MessageParcel &reply, MessageOption &option) override;
+    void OnError(int32_t errorCode) override;
+    void OnBuffersReleased(const std::vector<uint32_t> &bufferIds) override;
+    void OnSpaceAvailable() override;
+    void OnOutputFileSwitched(int64_t startTimeUs) override;
+    void SetCallback(const std::shared_ptr<AVMuxerCallback> &callback);
+    void SetBuffersReleasedNotifier(const BuffersReleasedNotifier &notifier);
+
+private:
+    std::mutex mutex_;
+    std::shared_ptr<AVMuxerCallback> callback_ = nullptr;
+    BuffersReleasedNotifier notifier_ = nullptr;
+};
+} // namespace Media
+} // namespace OHOS
+#endif // MUXER_LISTENER_STUB_H
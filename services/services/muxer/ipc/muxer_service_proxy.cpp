@@ -86,6 +86,38 @@ int32_t MuxerServiceProxy::SetRotation(int32_t rotation)
     return reply.ReadInt32();
 }
 
+int32_t MuxerServiceProxy::SetParameter(const MediaDescription &param)
+{
+    MessageParcel data;
+    MessageParcel reply;
+    MessageOption option;
+
+    bool token = data.WriteInterfaceToken(MuxerServiceProxy::GetDescriptor());
+    CHECK_AND_RETURN_RET_LOG(token, AVCS_ERR_INVALID_OPERATION, "Write descriptor failed!!");
+
+    AVCodecParcel::Marshalling(data, param);
+
+    int32_t ret = Remote()->SendRequest(SET_PARAMETER, data, reply, option);
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "SetParameter failed, error: %{public}d", ret);
+    return reply.ReadInt32();
+}
+
+int32_t MuxerServiceProxy::SetListenerObject(const sptr<IRemoteObject> &object)
+{
+    MessageParcel data;
+    MessageParcel reply;
+    MessageOption option;
+
+    bool token = data.WriteInterfaceToken(MuxerServiceProxy::GetDescriptor());
+    CHECK_AND_RETURN_RET_LOG(token, AVCS_ERR_INVALID_OPERATION, "Write descriptor failed!!");
+
+    CHECK_AND_RETURN_RET_LOG(data.WriteRemoteObject(object), AVCS_ERR_UNKNOWN, "Write listener object failed!");
+
+    int32_t ret = Remote()->SendRequest(SET_LISTENER_OBJ, data, reply, option);
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "SetListenerObject failed, error: %{public}d", ret);
+    return reply.ReadInt32();
+}
+
 int32_t MuxerServiceProxy::AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc)
 {
     MessageParcel data;
@@ -117,24 +149,101 @@ int32_t MuxerServiceProxy::Start()
     return reply.ReadInt32();
 }
 
-int32_t MuxerServiceProxy::WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info)
+int32_t MuxerServiceProxy::WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info,
+    uint32_t bufferId, bool async, std::vector<uint32_t> &releasedBufferIds)
 {
     MessageParcel data;
-    MessageParcel reply;
-    MessageOption option;
+    int32_t ret = PackSampleBuffer(data, sampleBuffer, info, bufferId, async);
+    if (ret != AVCS_ERR_OK) {
+        // nothing was sent, the memory may be registered already though.
+        memoryRegistry_.Reset();
+        releasedBufferIds.push_back(bufferId);
+        return ret;
+    }
+    return SendWriteRequest(WRITE_SAMPLE_BUFFER, data, bufferId, async, releasedBufferIds);
+}
+
+int32_t MuxerServiceProxy::WriteSampleBuffers(std::shared_ptr<AVSharedMemory> sampleBuffers,
+    const std::vector<TrackSampleInfo> &infos, const std::vector<uint32_t> &offsets,
+    uint32_t bufferId, bool async, std::vector<uint32_t> &releasedBufferIds)
+{
+    MessageParcel data;
+    int32_t ret = PackSampleBuffers(data, sampleBuffers, infos, offsets, bufferId, async);
+    if (ret != AVCS_ERR_OK) {
+        // nothing was sent, the memory may be registered already though.
+        memoryRegistry_.Reset();
+        releasedBufferIds.push_back(bufferId);
+        return ret;
+    }
+    return SendWriteRequest(WRITE_SAMPLE_BUFFERS, data, bufferId, async, releasedBufferIds);
+}
 
+int32_t MuxerServiceProxy::PackSampleBuffer(MessageParcel &data, std::shared_ptr<AVSharedMemory> sampleBuffer,
+    const TrackSampleInfo &info, uint32_t bufferId, bool async)
+{
     bool token = data.WriteInterfaceToken(MuxerServiceProxy::GetDescriptor());
     CHECK_AND_RETURN_RET_LOG(token, AVCS_ERR_INVALID_OPERATION, "Write descriptor failed!!");
 
-    WriteAVSharedMemoryToParcel(sampleBuffer, data);
+    CHECK_AND_RETURN_RET_LOG(data.WriteBool(async), AVCS_ERR_UNKNOWN, "Write async flag failed!");
+    CHECK_AND_RETURN_RET_LOG(memoryRegistry_.WriteToParcel(sampleBuffer, data) == AVCS_ERR_OK, AVCS_ERR_UNKNOWN,
+        "Write sampleBuffer failed!");
     CHECK_AND_RETURN_RET_LOG(data.WriteUint32(info.trackIndex), AVCS_ERR_UNKNOWN, "Write track index failed!");
     CHECK_AND_RETURN_RET_LOG(data.WriteInt64(info.timeUs), AVCS_ERR_UNKNOWN, "Write timeUs failed!");
+    CHECK_AND_RETURN_RET_LOG(data.WriteInt64(info.decodeTimeUs), AVCS_ERR_UNKNOWN, "Write decodeTimeUs failed!");
     CHECK_AND_RETURN_RET_LOG(data.WriteUint32(info.size), AVCS_ERR_UNKNOWN, "Write size failed!");
     CHECK_AND_RETURN_RET_LOG(data.WriteUint32(info.flags), AVCS_ERR_UNKNOWN, "Write flags failed!");
+    CHECK_AND_RETURN_RET_LOG(data.WriteUint32(bufferId), AVCS_ERR_UNKNOWN, "Write buffer id failed!");
+    return AVCS_ERR_OK;
+}
 
-    int32_t ret = Remote()->SendRequest(WRITE_SAMPLE_BUFFER, data, reply, option);
-    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "WriteSampleBuffer failed, error: %{public}d", ret);
-    return reply.ReadInt32();
+int32_t MuxerServiceProxy::PackSampleBuffers(MessageParcel &data, std::shared_ptr<AVSharedMemory> sampleBuffers,
+    const std::vector<TrackSampleInfo> &infos, const std::vector<uint32_t> &offsets, uint32_t bufferId, bool async)
+{
+    CHECK_AND_RETURN_RET_LOG(infos.size() == offsets.size(), AVCS_ERR_INVALID_VAL, "Sample count mismatch!");
+
+    bool token = data.WriteInterfaceToken(MuxerServiceProxy::GetDescriptor());
+    CHECK_AND_RETURN_RET_LOG(token, AVCS_ERR_INVALID_OPERATION, "Write descriptor failed!!");
+
+    CHECK_AND_RETURN_RET_LOG(data.WriteBool(async), AVCS_ERR_UNKNOWN, "Write async flag failed!");
+    CHECK_AND_RETURN_RET_LOG(memoryRegistry_.WriteToParcel(sampleBuffers, data) == AVCS_ERR_OK, AVCS_ERR_UNKNOWN,
+        "Write sampleBuffers failed!");
+    CHECK_AND_RETURN_RET_LOG(data.WriteUint32(bufferId), AVCS_ERR_UNKNOWN, "Write buffer id failed!");
+    CHECK_AND_RETURN_RET_LOG(data.WriteUint32(infos.size()), AVCS_ERR_UNKNOWN, "Write sample count failed!");
+    for (size_t i = 0; i < infos.size(); ++i) {
+        CHECK_AND_RETURN_RET_LOG(data.WriteUint32(infos[i].trackIndex), AVCS_ERR_UNKNOWN, "Write track index failed!");
+        CHECK_AND_RETURN_RET_LOG(data.WriteInt64(infos[i].timeUs), AVCS_ERR_UNKNOWN, "Write timeUs failed!");
+        CHECK_AND_RETURN_RET_LOG(data.WriteInt64(infos[i].decodeTimeUs), AVCS_ERR_UNKNOWN,
+            "Write decodeTimeUs failed!");
+        CHECK_AND_RETURN_RET_LOG(data.WriteUint32(infos[i].size), AVCS_ERR_UNKNOWN, "Write size failed!");
+        CHECK_AND_RETURN_RET_LOG(data.WriteUint32(infos[i].flags), AVCS_ERR_UNKNOWN, "Write flags failed!");
+        CHECK_AND_RETURN_RET_LOG(data.WriteUint32(offsets[i]), AVCS_ERR_UNKNOWN, "Write offset failed!");
+    }
+    return AVCS_ERR_OK;
+}
+
+int32_t MuxerServiceProxy::SendWriteRequest(uint32_t code, MessageParcel &data, uint32_t bufferId, bool async,
+    std::vector<uint32_t> &releasedBufferIds)
+{
+    MessageParcel reply;
+    MessageOption option(async ? MessageOption::TF_ASYNC : MessageOption::TF_SYNC);
+
+    int32_t ret = Remote()->SendRequest(code, data, reply, option);
+    if (ret != AVCS_ERR_OK) {
+        // the service may not have mapped the memories registered by this request, send them again next time.
+        memoryRegistry_.Reset();
+        // nor does it hold the buffer of the request, the client gets it back at once.
+        releasedBufferIds.push_back(bufferId);
+        AVCODEC_LOGE("Write sample request %{public}u failed, error: %{public}d", code, ret);
+        return ret;
+    }
+    if (async) {
+        asyncWriteCount_++;
+        return AVCS_ERR_OK;
+    }
+    ret = reply.ReadInt32();
+    CHECK_AND_RETURN_RET_LOG(reply.ReadUInt32Vector(&releasedBufferIds), AVCS_ERR_UNKNOWN,
+        "Read released buffer ids failed!");
+    return ret;
 }
 
 int32_t MuxerServiceProxy::Stop()
@@ -146,11 +255,29 @@ int32_t MuxerServiceProxy::Stop()
     bool token = data.WriteInterfaceToken(MuxerServiceProxy::GetDescriptor());
     CHECK_AND_RETURN_RET_LOG(token, AVCS_ERR_INVALID_OPERATION, "Write descriptor failed!!");
 
+    CHECK_AND_RETURN_RET_LOG(data.WriteUint64(asyncWriteCount_), AVCS_ERR_UNKNOWN, "Write async count failed!");
+
     int32_t ret = Remote()->SendRequest(STOP, data, reply, option);
     CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Stop failed, error: %{public}d", ret);
     return reply.ReadInt32();
 }
 
+int32_t MuxerServiceProxy::SetNextOutputFile(int32_t fd)
+{
+    MessageParcel data;
+    MessageParcel reply;
+    MessageOption option;
+
+    bool token = data.WriteInterfaceToken(MuxerServiceProxy::GetDescriptor());
+    CHECK_AND_RETURN_RET_LOG(token, AVCS_ERR_INVALID_OPERATION, "Write descriptor failed!!");
+
+    CHECK_AND_RETURN_RET_LOG(data.WriteFileDescriptor(fd), AVCS_ERR_UNKNOWN, "Write fd failed!");
+
+    int32_t ret = Remote()->SendRequest(SET_NEXT_OUTPUT_FILE, data, reply, option);
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "SetNextOutputFile failed, error: %{public}d", ret);
+    return reply.ReadInt32();
+}
+
 int32_t MuxerServiceProxy::DestroyStub()
 {
     MessageParcel data;
@@ -160,6 +287,8 @@ int32_t MuxerServiceProxy::DestroyStub()
     bool token = data.WriteInterfaceToken(MuxerServiceProxy::GetDescriptor());
     CHECK_AND_RETURN_RET_LOG(token, AVCS_ERR_INVALID_OPERATION, "Write descriptor failed!!");
 
+    CHECK_AND_RETURN_RET_LOG(data.WriteUint64(asyncWriteCount_), AVCS_ERR_UNKNOWN, "Write async count failed!");
+
     int ret = Remote()->SendRequest(DESTROY, data, reply, option);
     CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Call DestroyStub failed, error: %{public}d", ret);
     return reply.ReadInt32();
@@ -174,6 +303,8 @@ void MuxerServiceProxy::Release()
     bool token = data.WriteInterfaceToken(MuxerServiceProxy::GetDescriptor());
     CHECK_AND_RETURN_LOG(token, "Write descriptor failed!");
 
+    CHECK_AND_RETURN_LOG(data.WriteUint64(asyncWriteCount_), "Write async count failed!");
+
     int ret = Remote()->SendRequest(RELEASE, data, reply, option);
     CHECK_AND_RETURN_LOG(ret == AVCS_ERR_OK, " Call Release failed, error: %{public}d", ret);
 }
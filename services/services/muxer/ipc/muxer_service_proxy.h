@@ -17,6 +17,7 @@
 #define MUXER_SERVICE_PROXY_H
 
 #include "i_standard_muxer_service.h"
+#include "avsharedmemory_ipc.h"
 
 namespace OHOS {
 namespace Media {
@@ -28,14 +29,32 @@ public:
     int32_t InitParameter(int32_t fd, OutputFormat format) override;
     int32_t SetLocation(float latitude, float longitude) override;
     int32_t SetRotation(int32_t rotation) override;
+    int32_t SetParameter(const MediaDescription &param) override;
+    int32_t SetListenerObject(const sptr<IRemoteObject> &object) override;
     int32_t AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc) override;
     int32_t Start() override;
-    int32_t WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info) override;
+    int32_t WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info,
+        uint32_t bufferId, bool async, std::vector<uint32_t> &releasedBufferIds) override;
+    int32_t WriteSampleBuffers(std::shared_ptr<AVSharedMemory> sampleBuffers,
+        const std::vector<TrackSampleInfo> &infos, const std::vector<uint32_t> &offsets,
+        uint32_t bufferId, bool async, std::vector<uint32_t> &releasedBufferIds) override;
     int32_t Stop() override;
+    int32_t SetNextOutputFile(int32_t fd) override;
     void Release() override;
     int32_t DestroyStub() override;
 private:
+    int32_t PackSampleBuffer(MessageParcel &data, std::shared_ptr<AVSharedMemory> sampleBuffer,
+        const TrackSampleInfo &info, uint32_t bufferId, bool async);
+    int32_t PackSampleBuffers(MessageParcel &data, std::shared_ptr<AVSharedMemory> sampleBuffers,
+        const std::vector<TrackSampleInfo> &infos, const std::vector<uint32_t> &offsets, uint32_t bufferId, bool async);
+    int32_t SendWriteRequest(uint32_t code, MessageParcel &data, uint32_t bufferId, bool async,
+        std::vector<uint32_t> &releasedBufferIds);
+
     static inline BrokerDelegator<MuxerServiceProxy> delegator_;
+    AVSharedMemoryRegistry memoryRegistry_;
+    // one-way requests sent so far, the service waits for them before handling Stop, Release and DestroyStub
+    // because binder does not order one-way requests against synchronous ones.
+    uint64_t asyncWriteCount_ = 0;
 };
 }  // namespace Media
 }  // namespace OHOS
@@ -14,18 +14,51 @@
  */
 
 #include "muxer_service_stub.h"
+#include <unistd.h>
 #include "avcodec_server_manager.h"
 #include "avcodec_errors.h"
 #include "avcodec_log.h"
 #include "avsharedmemory_ipc.h"
 #include "avcodec_parcel.h"
+#include "muxer_listener_proxy.h"
 
 namespace {
     constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "MuxerServiceStub"};
+    constexpr uint32_t MAX_BATCH_SAMPLE_COUNT = 1024;
+    constexpr int32_t ASYNC_WRITE_WAIT_TIMEOUT_MS = 3000;
 }
 
 namespace OHOS {
 namespace Media {
+namespace {
+class AVSharedMemoryView : public AVSharedMemory {
+public:
+    AVSharedMemoryView(const std::shared_ptr<AVSharedMemory> &memory, uint32_t offset, int32_t size)
+        : memory_(memory), offset_(offset), size_(size) {}
+    ~AVSharedMemoryView() override = default;
+
+    uint8_t *GetBase() const override
+    {
+        return memory_->GetBase() + offset_;
+    }
+
+    int32_t GetSize() const override
+    {
+        return size_;
+    }
+
+    uint32_t GetFlags() const override
+    {
+        return memory_->GetFlags();
+    }
+
+private:
+    std::shared_ptr<AVSharedMemory> memory_;
+    uint32_t offset_;
+    int32_t size_;
+};
+}
+
 sptr<MuxerServiceStub> MuxerServiceStub::Create()
 {
     sptr<MuxerServiceStub> muxerStub = new(std::nothrow) MuxerServiceStub();
@@ -60,6 +93,10 @@ int32_t MuxerServiceStub::Init()
     muxerFuncs_[STOP] = &MuxerServiceStub::Stop;
     muxerFuncs_[RELEASE] = &MuxerServiceStub::Release;
     muxerFuncs_[DESTROY] = &MuxerServiceStub::DestroyStub;
+    muxerFuncs_[SET_PARAMETER] = &MuxerServiceStub::SetParameter;
+    muxerFuncs_[WRITE_SAMPLE_BUFFERS] = &MuxerServiceStub::WriteSampleBuffers;
+    muxerFuncs_[SET_LISTENER_OBJ] = &MuxerServiceStub::SetListenerObject;
+    muxerFuncs_[SET_NEXT_OUTPUT_FILE] = &MuxerServiceStub::SetNextOutputFile;
     return AVCS_ERR_OK;
 }
 
@@ -102,6 +139,30 @@ int32_t MuxerServiceStub::SetRotation(int32_t rotation)
     return muxerServer_->SetRotation(rotation);
 }
 
+int32_t MuxerServiceStub::SetParameter(const MediaDescription &param)
+{
+    CHECK_AND_RETURN_RET_LOG(muxerServer_ != nullptr, AVCS_ERR_NO_MEMORY, "Muxer Service does not exist");
+    return muxerServer_->SetParameter(param);
+}
+
+int32_t MuxerServiceStub::SetListenerObject(const sptr<IRemoteObject> &object)
+{
+    CHECK_AND_RETURN_RET_LOG(object != nullptr, AVCS_ERR_NO_MEMORY, "set listener object is nullptr");
+    CHECK_AND_RETURN_RET_LOG(muxerServer_ != nullptr, AVCS_ERR_NO_MEMORY, "Muxer Service does not exist");
+
+    sptr<IStandardMuxerListener> listener = iface_cast<IStandardMuxerListener>(object);
+    CHECK_AND_RETURN_RET_LOG(listener != nullptr, AVCS_ERR_NO_MEMORY, "failed to convert IStandardMuxerListener");
+
+    std::shared_ptr<AVMuxerCallback> callback = std::make_shared<MuxerListenerCallback>(listener);
+    CHECK_AND_RETURN_RET_LOG(callback != nullptr, AVCS_ERR_NO_MEMORY, "failed to new MuxerListenerCallback");
+    int32_t ret = muxerServer_->SetCallback(callback);
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Set muxer callback failed");
+
+    std::lock_guard<std::mutex> lock(asyncMutex_);
+    listener_ = listener;
+    return AVCS_ERR_OK;
+}
+
 int32_t MuxerServiceStub::AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc)
 {
     CHECK_AND_RETURN_RET_LOG(muxerServer_ != nullptr, AVCS_ERR_NO_MEMORY, "Muxer Service does not exist");
@@ -114,11 +175,69 @@ int32_t MuxerServiceStub::Start()
     return muxerServer_->Start();
 }
 
-int32_t MuxerServiceStub::WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info)
+int32_t MuxerServiceStub::WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info,
+    uint32_t bufferId, bool async, std::vector<uint32_t> &releasedBufferIds)
 {
+    (void)async;
     CHECK_AND_RETURN_RET_LOG(sampleBuffer != nullptr, AVCS_ERR_INVALID_VAL, "sampleData is nullptr");
     CHECK_AND_RETURN_RET_LOG(muxerServer_ != nullptr, AVCS_ERR_NO_MEMORY, "Muxer Service does not exist");
-    return muxerServer_->WriteSampleBuffer(sampleBuffer, info);
+    CHECK_AND_RETURN_RET_LOG(!IsWriteClosed(), AVCS_ERR_INVALID_STATE, "The muxer is stopping, reject the sample");
+
+    std::shared_ptr<AVSharedMemory> trackedBuffer = TrackSampleBuffer(sampleBuffer, bufferId);
+    int32_t ret = muxerServer_->WriteSampleBuffer(trackedBuffer, info);
+    trackedBuffer = nullptr;
+    TakeReleasedBufferIds(releasedBufferIds);
+    return ret;
+}
+
+int32_t MuxerServiceStub::WriteSampleBuffers(std::shared_ptr<AVSharedMemory> sampleBuffers,
+    const std::vector<TrackSampleInfo> &infos, const std::vector<uint32_t> &offsets,
+    uint32_t bufferId, bool async, std::vector<uint32_t> &releasedBufferIds)
+{
+    (void)async;
+    CHECK_AND_RETURN_RET_LOG(sampleBuffers != nullptr, AVCS_ERR_INVALID_VAL, "sampleData is nullptr");
+    CHECK_AND_RETURN_RET_LOG(muxerServer_ != nullptr, AVCS_ERR_NO_MEMORY, "Muxer Service does not exist");
+    CHECK_AND_RETURN_RET_LOG(!IsWriteClosed(), AVCS_ERR_INVALID_STATE, "The muxer is stopping, reject the sample");
+    CHECK_AND_RETURN_RET_LOG(infos.size() == offsets.size(), AVCS_ERR_INVALID_VAL, "Sample count mismatch");
+
+    std::shared_ptr<AVSharedMemory> trackedBuffer = TrackSampleBuffer(sampleBuffers, bufferId);
+    int32_t ret = AVCS_ERR_OK;
+    uint64_t memorySize = static_cast<uint64_t>(sampleBuffers->GetSize());
+    for (size_t i = 0; i < infos.size() && ret == AVCS_ERR_OK; ++i) {
+        if (static_cast<uint64_t>(offsets[i]) + infos[i].size > memorySize || infos[i].size > INT32_MAX) {
+            AVCODEC_LOGE("Sample %{public}zu exceeds the shared memory", i);
+            ret = AVCS_ERR_INVALID_VAL;
+            break;
+        }
+        std::shared_ptr<AVSharedMemory> sample = std::make_shared<AVSharedMemoryView>(
+            trackedBuffer, offsets[i], static_cast<int32_t>(infos[i].size));
+        ret = muxerServer_->WriteSampleBuffer(sample, infos[i]);
+    }
+    trackedBuffer = nullptr;
+    TakeReleasedBufferIds(releasedBufferIds);
+    return ret;
+}
+
+std::shared_ptr<AVSharedMemory> MuxerServiceStub::TrackSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer,
+    uint32_t bufferId)
+{
+    // the engine drops its reference once the sample is written, record the id then so the client may reuse it.
+    std::weak_ptr<ReleasedBuffers> weakReleased = releasedBuffers_;
+    return std::shared_ptr<AVSharedMemory>(sampleBuffer.get(),
+        [sampleBuffer, bufferId, weakReleased](AVSharedMemory *) {
+            std::shared_ptr<ReleasedBuffers> released = weakReleased.lock();
+            if (released != nullptr) {
+                std::lock_guard<std::mutex> lock(released->mutex);
+                released->ids.push_back(bufferId);
+            }
+        });
+}
+
+void MuxerServiceStub::TakeReleasedBufferIds(std::vector<uint32_t> &releasedBufferIds)
+{
+    std::lock_guard<std::mutex> lock(releasedBuffers_->mutex);
+    releasedBufferIds.swap(releasedBuffers_->ids);
+    releasedBuffers_->ids.clear();
 }
 
 int32_t MuxerServiceStub::Stop()
@@ -127,15 +246,27 @@ int32_t MuxerServiceStub::Stop()
     return muxerServer_->Stop();
 }
 
+int32_t MuxerServiceStub::SetNextOutputFile(int32_t fd)
+{
+    CHECK_AND_RETURN_RET_LOG(muxerServer_ != nullptr, AVCS_ERR_NO_MEMORY, "Muxer Service does not exist");
+    return muxerServer_->SetNextOutputFile(fd);
+}
+
 void MuxerServiceStub::Release()
 {
     CHECK_AND_RETURN_LOG(muxerServer_ != nullptr, "Muxer Service does not exist");
     muxerServer_->Release();
+    memoryCache_.Clear();
 }
 
 int32_t MuxerServiceStub::DestroyStub()
 {
     muxerServer_ = nullptr;
+    memoryCache_.Clear();
+    {
+        std::lock_guard<std::mutex> lock(asyncMutex_);
+        listener_ = nullptr;
+    }
     AVCodecServerManager::GetInstance().DestroyStubObject(AVCodecServerManager::MUXER, AsObject());
     return AVCS_ERR_OK;
 }
@@ -171,6 +302,22 @@ int32_t MuxerServiceStub::SetRotation(MessageParcel &data, MessageParcel &reply)
     return AVCS_ERR_OK;
 }
 
+int32_t MuxerServiceStub::SetParameter(MessageParcel &data, MessageParcel &reply)
+{
+    MediaDescription param;
+    (void)AVCodecParcel::Unmarshalling(data, param);
+    CHECK_AND_RETURN_RET_LOG(reply.WriteInt32(SetParameter(param)), AVCS_ERR_UNKNOWN, "Reply SetParameter failed!");
+    return AVCS_ERR_OK;
+}
+
+int32_t MuxerServiceStub::SetListenerObject(MessageParcel &data, MessageParcel &reply)
+{
+    sptr<IRemoteObject> object = data.ReadRemoteObject();
+    CHECK_AND_RETURN_RET_LOG(reply.WriteInt32(SetListenerObject(object)), AVCS_ERR_UNKNOWN,
+        "Reply SetListenerObject failed!");
+    return AVCS_ERR_OK;
+}
+
 int32_t MuxerServiceStub::AddTrack(MessageParcel &data, MessageParcel &reply)
 {
     MediaDescription trackDesc;
@@ -191,28 +338,123 @@ int32_t MuxerServiceStub::Start(MessageParcel &data, MessageParcel &reply)
 
 int32_t MuxerServiceStub::WriteSampleBuffer(MessageParcel &data, MessageParcel &reply)
 {
-    std::shared_ptr<AVSharedMemory> sampleBuffer = ReadAVSharedMemoryFromParcel(data);
-    CHECK_AND_RETURN_RET_LOG(sampleBuffer != nullptr, AVCS_ERR_UNKNOWN, "Read sampleBuffer from parcel failed!");
+    bool async = data.ReadBool();
+    std::shared_ptr<AVSharedMemory> sampleBuffer = memoryCache_.ReadFromParcel(data);
     TrackSampleInfo info;
     info.trackIndex = data.ReadUint32();
     info.timeUs = data.ReadInt64();
+    info.decodeTimeUs = data.ReadInt64();
     info.size = data.ReadUint32();
     info.flags = data.ReadUint32();
-    int32_t ret = WriteSampleBuffer(sampleBuffer, info);
-    CHECK_AND_RETURN_RET_LOG(reply.WriteInt32(ret), AVCS_ERR_UNKNOWN, "Reply WriteSampleBuffer failed!");
+    uint32_t bufferId = data.ReadUint32();
+    std::vector<uint32_t> releasedBufferIds;
+    int32_t ret = WriteSampleBuffer(sampleBuffer, info, bufferId, async, releasedBufferIds);
+    return ReplyWriteResult(ret, async, releasedBufferIds, reply);
+}
+
+int32_t MuxerServiceStub::WriteSampleBuffers(MessageParcel &data, MessageParcel &reply)
+{
+    bool async = data.ReadBool();
+    std::shared_ptr<AVSharedMemory> sampleBuffers = memoryCache_.ReadFromParcel(data);
+    uint32_t bufferId = data.ReadUint32();
+    uint32_t count = data.ReadUint32();
+    std::vector<uint32_t> releasedBufferIds;
+    if (count > MAX_BATCH_SAMPLE_COUNT) {
+        AVCODEC_LOGE("Too many samples in one batch: %{public}u", count);
+        return ReplyWriteResult(AVCS_ERR_INVALID_VAL, async, releasedBufferIds, reply);
+    }
+    std::vector<TrackSampleInfo> infos(count);
+    std::vector<uint32_t> offsets(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        infos[i].trackIndex = data.ReadUint32();
+        infos[i].timeUs = data.ReadInt64();
+        infos[i].decodeTimeUs = data.ReadInt64();
+        infos[i].size = data.ReadUint32();
+        infos[i].flags = data.ReadUint32();
+        offsets[i] = data.ReadUint32();
+    }
+    int32_t ret = WriteSampleBuffers(sampleBuffers, infos, offsets, bufferId, async, releasedBufferIds);
+    return ReplyWriteResult(ret, async, releasedBufferIds, reply);
+}
+
+int32_t MuxerServiceStub::ReplyWriteResult(int32_t ret, bool async, const std::vector<uint32_t> &releasedBufferIds,
+    MessageParcel &reply)
+{
+    if (!async) {
+        CHECK_AND_RETURN_RET_LOG(reply.WriteInt32(ret), AVCS_ERR_UNKNOWN, "Reply write result failed!");
+        CHECK_AND_RETURN_RET_LOG(reply.WriteUInt32Vector(releasedBufferIds), AVCS_ERR_UNKNOWN,
+            "Reply released buffer ids failed!");
+        return AVCS_ERR_OK;
+    }
+
+    // nobody waits for the reply of a one-way request, report through the listener instead.
+    sptr<IStandardMuxerListener> listener = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(asyncMutex_);
+        listener = listener_;
+    }
+    if (listener != nullptr) {
+        if (ret != AVCS_ERR_OK) {
+            listener->OnError(ret);
+        }
+        if (!releasedBufferIds.empty()) {
+            listener->OnBuffersReleased(releasedBufferIds);
+        }
+    } else if (ret != AVCS_ERR_OK) {
+        AVCODEC_LOGE("Asynchronous write failed with %{public}d and no listener is set", ret);
+    }
+
+    std::lock_guard<std::mutex> lock(asyncMutex_);
+    asyncWriteProcessed_++;
+    asyncCond_.notify_all();
+    return AVCS_ERR_OK;
+}
+
+int32_t MuxerServiceStub::WaitAsyncWrites(MessageParcel &data)
+{
+    uint64_t asyncWriteCount = data.ReadUint64();
+    std::unique_lock<std::mutex> lock(asyncMutex_);
+    bool done = asyncCond_.wait_for(lock, std::chrono::milliseconds(ASYNC_WRITE_WAIT_TIMEOUT_MS),
+        [this, asyncWriteCount] { return asyncWriteProcessed_ >= asyncWriteCount; });
+    // stopping is final, a one-way write that arrives from now on must not reach the stopped muxer.
+    writeClosed_ = true;
+    CHECK_AND_RETURN_RET_LOG(done, AVCS_ERR_UNKNOWN,
+        "Wait for asynchronous writes timeout, processed %{public}" PRIu64 " of %{public}" PRIu64,
+        asyncWriteProcessed_, asyncWriteCount);
     return AVCS_ERR_OK;
 }
 
+bool MuxerServiceStub::IsWriteClosed()
+{
+    std::lock_guard<std::mutex> lock(asyncMutex_);
+    return writeClosed_;
+}
+
 int32_t MuxerServiceStub::Stop(MessageParcel &data, MessageParcel &reply)
 {
-    (void)data;
-    CHECK_AND_RETURN_RET_LOG(reply.WriteInt32(Stop()), AVCS_ERR_UNKNOWN, "Reply Stop failed!");
+    int32_t waitRet = WaitAsyncWrites(data);
+    // the file is still finished with the samples that did arrive, but the caller learns some may be missing.
+    int32_t ret = Stop();
+    CHECK_AND_RETURN_RET_LOG(reply.WriteInt32(waitRet != AVCS_ERR_OK ? waitRet : ret), AVCS_ERR_UNKNOWN,
+        "Reply Stop failed!");
+    return AVCS_ERR_OK;
+}
+
+int32_t MuxerServiceStub::SetNextOutputFile(MessageParcel &data, MessageParcel &reply)
+{
+    int32_t fd = data.ReadFileDescriptor();
+    int32_t ret = SetNextOutputFile(fd);
+    // the engine keeps its own duplicate, the one received from the parcel is owned here.
+    if (fd >= 0) {
+        (void)close(fd);
+    }
+    CHECK_AND_RETURN_RET_LOG(reply.WriteInt32(ret), AVCS_ERR_UNKNOWN, "Reply SetNextOutputFile failed!");
     return AVCS_ERR_OK;
 }
 
 int32_t MuxerServiceStub::Release(MessageParcel &data, MessageParcel &reply)
 {
-    (void)data;
+    (void)WaitAsyncWrites(data);
     (void)reply;
     Release();
     return AVCS_ERR_OK;
@@ -220,7 +462,7 @@ int32_t MuxerServiceStub::Release(MessageParcel &data, MessageParcel &reply)
 
 int32_t MuxerServiceStub::DestroyStub(MessageParcel &data, MessageParcel &reply)
 {
-    (void)data;
+    (void)WaitAsyncWrites(data);
     CHECK_AND_RETURN_RET_LOG(reply.WriteInt32(DestroyStub()), AVCS_ERR_UNKNOWN, "Reply DestroyStub failed!");
     return AVCS_ERR_OK;
 }
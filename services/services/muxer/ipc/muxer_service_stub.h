@@ -16,8 +16,13 @@
 #ifndef MUXER_SERVICE_STUB_H
 #define MUXER_SERVICE_STUB_H
 
+#include <condition_variable>
+#include <mutex>
+#include <vector>
 #include "i_standard_muxer_service.h"
+#include "i_standard_muxer_listener.h"
 #include "muxer_server.h"
+#include "avsharedmemory_ipc.h"
 #include "iremote_stub.h"
 
 namespace OHOS {
@@ -32,10 +37,17 @@ public:
     int32_t InitParameter(int32_t fd, OutputFormat format) override;
     int32_t SetLocation(float latitude, float longitude) override;
     int32_t SetRotation(int32_t rotation) override;
+    int32_t SetParameter(const MediaDescription &param) override;
+    int32_t SetListenerObject(const sptr<IRemoteObject> &object) override;
     int32_t AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc) override;
     int32_t Start() override;
-    int32_t WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info) override;
+    int32_t WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info,
+        uint32_t bufferId, bool async, std::vector<uint32_t> &releasedBufferIds) override;
+    int32_t WriteSampleBuffers(std::shared_ptr<AVSharedMemory> sampleBuffers,
+        const std::vector<TrackSampleInfo> &infos, const std::vector<uint32_t> &offsets,
+        uint32_t bufferId, bool async, std::vector<uint32_t> &releasedBufferIds) override;
     int32_t Stop() override;
+    int32_t SetNextOutputFile(int32_t fd) override;
     void Release() override;
     int32_t DestroyStub() override;
     int32_t DumpInfo(int32_t fd);
@@ -43,18 +55,40 @@ public:
 private:
     MuxerServiceStub();
     int32_t Init();
+    std::shared_ptr<AVSharedMemory> TrackSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, uint32_t bufferId);
+    void TakeReleasedBufferIds(std::vector<uint32_t> &releasedBufferIds);
+    int32_t ReplyWriteResult(int32_t ret, bool async, const std::vector<uint32_t> &releasedBufferIds,
+        MessageParcel &reply);
+    int32_t WaitAsyncWrites(MessageParcel &data);
+    bool IsWriteClosed();
     int32_t InitParameter(MessageParcel &data, MessageParcel &reply);
     int32_t SetLocation(MessageParcel &data, MessageParcel &reply);
     int32_t SetRotation(MessageParcel &data, MessageParcel &reply);
+    int32_t SetParameter(MessageParcel &data, MessageParcel &reply);
+    int32_t SetListenerObject(MessageParcel &data, MessageParcel &reply);
     int32_t AddTrack(MessageParcel &data, MessageParcel &reply);
     int32_t Start(MessageParcel &data, MessageParcel &reply);
     int32_t WriteSampleBuffer(MessageParcel &data, MessageParcel &reply);
+    int32_t WriteSampleBuffers(MessageParcel &data, MessageParcel &reply);
     int32_t Stop(MessageParcel &data, MessageParcel &reply);
+    int32_t SetNextOutputFile(MessageParcel &data, MessageParcel &reply);
     int32_t Release(MessageParcel &data, MessageParcel &reply);
     int32_t DestroyStub(MessageParcel &data, MessageParcel &reply);
 
+    struct ReleasedBuffers {
+        std::mutex mutex;
+        std::vector<uint32_t> ids;
+    };
+
     std::shared_ptr<IMuxerService> muxerServer_ {nullptr};
     std::map<uint32_t, MuxerStubFunc> muxerFuncs_;
+    std::shared_ptr<ReleasedBuffers> releasedBuffers_ = std::make_shared<ReleasedBuffers>();
+    AVSharedMemoryCache memoryCache_;
+    std::mutex asyncMutex_;
+    std::condition_variable asyncCond_;
+    uint64_t asyncWriteProcessed_ = 0;
+    bool writeClosed_ = false;
+    sptr<IStandardMuxerListener> listener_ = nullptr;
 };
 }  // namespace Media
 }  // namespace OHOS
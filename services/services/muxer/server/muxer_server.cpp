@@ -68,6 +68,22 @@ int32_t MuxerServer::SetRotation(int32_t rotation)
     return AVCS_ERR_OK;
 }
 
+int32_t MuxerServer::SetParameter(const MediaDescription &param)
+{
+    CHECK_AND_RETURN_RET_LOG(muxerEngine_ != nullptr, AVCS_ERR_INVALID_OPERATION, "muxer engine does not exist");
+    int32_t ret = muxerEngine_->SetParameter(param);
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Failed to call SetParameter");
+    return AVCS_ERR_OK;
+}
+
+int32_t MuxerServer::SetCallback(const std::shared_ptr<AVMuxerCallback> &callback)
+{
+    CHECK_AND_RETURN_RET_LOG(muxerEngine_ != nullptr, AVCS_ERR_INVALID_OPERATION, "muxer engine does not exist");
+    int32_t ret = muxerEngine_->SetCallback(callback);
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Failed to call SetCallback");
+    return AVCS_ERR_OK;
+}
+
 int32_t MuxerServer::AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc)
 {
     CHECK_AND_RETURN_RET_LOG(muxerEngine_ != nullptr, AVCS_ERR_INVALID_OPERATION, "muxer engine does not exist");
@@ -101,6 +117,14 @@ int32_t MuxerServer::Stop()
     return AVCS_ERR_OK;
 }
 
+int32_t MuxerServer::SetNextOutputFile(int32_t fd)
+{
+    CHECK_AND_RETURN_RET_LOG(muxerEngine_ != nullptr, AVCS_ERR_INVALID_OPERATION, "muxer engine does not exist");
+    int32_t ret = muxerEngine_->SetNextOutputFile(fd);
+    CHECK_AND_RETURN_RET_LOG(ret == AVCS_ERR_OK, ret, "Failed to call SetNextOutputFile");
+    return AVCS_ERR_OK;
+}
+
 void MuxerServer::Release()
 {
     CHECK_AND_RETURN_LOG(muxerEngine_ != nullptr, "muxer engine does not exist");
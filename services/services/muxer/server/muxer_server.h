@@ -32,10 +32,13 @@ public:
     int32_t InitParameter(int32_t fd, OutputFormat format) override;
     int32_t SetLocation(float latitude, float longitude) override;
     int32_t SetRotation(int32_t rotation) override;
+    int32_t SetParameter(const MediaDescription &param) override;
+    int32_t SetCallback(const std::shared_ptr<AVMuxerCallback> &callback) override;
     int32_t AddTrack(int32_t &trackIndex, const MediaDescription &trackDesc) override;
     int32_t Start() override;
     int32_t WriteSampleBuffer(std::shared_ptr<AVSharedMemory> sampleBuffer, const TrackSampleInfo &info) override;
     int32_t Stop() override;
+    int32_t SetNextOutputFile(int32_t fd) override;
     void Release() override;
     int32_t DumpInfo(int32_t fd);
 
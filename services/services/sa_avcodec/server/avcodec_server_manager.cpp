@@ -24,6 +24,7 @@
 #include "avcodec_xcollie.h"
 #ifdef SUPPORT_MUXER
 #include "muxer_service_stub.h"
+#include "muxer_factory.h"
 #endif
 
 namespace {
@@ -84,6 +85,9 @@ int32_t AVCodecServerManager::Dump(int32_t fd, const std::vector<std::u16string>
         AVCODEC_LOGW("Failed to write MuxerServer information");
         return OHOS::INVALID_OPERATION;
     }
+    if (argSets.find(u"muxer") != argSets.end()) {
+        (void)Plugin::MuxerFactory::Instance().DumpInfo(fd);
+    }
 #endif
 
     if (AVCodecXCollie::GetInstance().Dump(fd) != OHOS::NO_ERROR) {
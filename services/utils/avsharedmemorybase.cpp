@@ -14,6 +14,7 @@
  */
 
 #include "avsharedmemorybase.h"
+#include <atomic>
 #include <sys/mman.h>
 #include <unistd.h>
 #include "ashmem.h"
@@ -23,6 +24,7 @@
 
 namespace {
     constexpr OHOS::HiviewDFX::HiLogLabel LABEL = {LOG_CORE, LOG_DOMAIN, "AVSharedMemoryBase"};
+    std::atomic<uint64_t> g_nextUniqueId = 1;
 }
 
 namespace OHOS {
@@ -60,14 +62,16 @@ std::shared_ptr<AVSharedMemory> AVSharedMemoryBase::CreateFromRemote(
 }
 
 AVSharedMemoryBase::AVSharedMemoryBase(int32_t size, uint32_t flags, const std::string &name)
-    : base_(nullptr), size_(size), flags_(flags), name_(name), fd_(-1)
+    : base_(nullptr), size_(size), flags_(flags), name_(name), fd_(-1),
+      aliveToken_(std::make_shared<const uint64_t>(g_nextUniqueId.fetch_add(1, std::memory_order_relaxed)))
 {
     AVCODEC_LOGD("enter ctor, instance: 0x%{public}06" PRIXPTR ", name = %{public}s",
                FAKE_POINTER(this), name_.c_str());
 }
 
 AVSharedMemoryBase::AVSharedMemoryBase(int32_t fd, int32_t size, uint32_t flags, const std::string &name)
-    : base_(nullptr), size_(size), flags_(flags), name_(name), fd_(dup(fd))
+    : base_(nullptr), size_(size), flags_(flags), name_(name), fd_(dup(fd)),
+      aliveToken_(std::make_shared<const uint64_t>(g_nextUniqueId.fetch_add(1, std::memory_order_relaxed)))
 {
     AVCODEC_LOGD("enter ctor, instance: 0x%{public}06" PRIXPTR ", name = %{public}s",
                FAKE_POINTER(this), name_.c_str());
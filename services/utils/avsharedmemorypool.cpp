@@ -145,9 +145,7 @@ bool AVSharedMemoryPool::DoAcquireMemory(int32_t size, AVSharedMemory **outMemor
         if (totalCnt < option_.maxMemCnt) {
             result = AllocMemory(size);
             CHECK_AND_RETURN_RET_LOG(result != nullptr, false, "result is nullptr, AllocMemory failed.");
-        }
-
-        if (!option_.enableFixedSize && minSizeIdleMem != idleList_.end()) {
+        } else if (!option_.enableFixedSize && minSizeIdleMem != idleList_.end()) {
             delete *minSizeIdleMem;
             *minSizeIdleMem = nullptr;
             idleList_.erase(minSizeIdleMem);
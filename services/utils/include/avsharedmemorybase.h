@@ -16,6 +16,7 @@
 #ifndef AVSHAREDMEMORYBASE_H
 #define AVSHAREDMEMORYBASE_H
 
+#include <memory>
 #include <string>
 #include "nocopyable.h"
 #include "avsharedmemory.h"
@@ -81,6 +82,25 @@ public:
         return name_;
     }
 
+    /**
+     * @brief Get the id that identifies this memory object within the process, ids are never reused.
+     * @return the memory's unique id.
+     */
+    uint64_t GetUniqueId() const
+    {
+        return *aliveToken_;
+    }
+
+    /**
+     * @brief Get a token that lives exactly as long as this memory object, the holder of a weak reference
+     * to it can learn that the memory has been destroyed.
+     * @return the weak reference to the alive token.
+     */
+    std::weak_ptr<const uint64_t> GetAliveToken() const
+    {
+        return aliveToken_;
+    }
+
     /**
      * @brief Get the memory's virtual address
      * @return the memory's virtual address if the memory is valid, otherwise nullptr.
@@ -120,6 +140,7 @@ private:
     uint32_t flags_;
     std::string name_;
     int32_t fd_;
+    std::shared_ptr<const uint64_t> aliveToken_;
 };
 } // namespace Media
 } // namespace OHOS
@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2023 Huawei Device Co., Ltd.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UTILS_SPSC_RING_QUEUE_H
+#define UTILS_SPSC_RING_QUEUE_H
+#include <atomic>
+#include <string>
+#include <vector>
+#include <climits>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace OHOS {
+namespace Media {
+namespace Detail {
+constexpr size_t DEFAULT_RING_QUEUE_SIZE = 16;
+constexpr size_t RING_QUEUE_CACHE_LINE = 64;
+} // namespace Detail
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer thread.
+ * Several producer threads are allowed as long as they are serialized by the caller.
+ * Push and Pop only touch atomics on the fast path; a thread parks on a futex only
+ * when the queue is full (producer) or empty (consumer), and the other side issues
+ * the wake syscall only if it sees a parked peer.
+ */
+template <typename T>
+class SpscRingQueue {
+public:
+    explicit SpscRingQueue(std::string name, size_t capacity = Detail::DEFAULT_RING_QUEUE_SIZE)
+        : name_(std::move(name))
+    {
+        Reset(capacity);
+    }
+
+    ~SpscRingQueue() = default;
+
+    SpscRingQueue(const SpscRingQueue &) = delete;
+    SpscRingQueue &operator=(const SpscRingQueue &) = delete;
+
+    size_t Size() const
+    {
+        size_t tail = tail_.load(std::memory_order_acquire);
+        size_t head = head_.load(std::memory_order_acquire);
+        return tail - head;
+    }
+
+    size_t Capacity() const
+    {
+        return capacity_;
+    }
+
+    bool Empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    const std::string &Name() const
+    {
+        return name_;
+    }
+
+    // Drops the queued data and changes the capacity, only allowed while neither side is using the queue.
+    void Reset(size_t capacity)
+    {
+        capacity_ = capacity > 0 ? capacity : 1;
+        size_t slotCount = RoundUpCapacity(capacity_);
+        mask_ = slotCount - 1;
+        std::vector<T>(slotCount).swap(slots_);
+        head_.store(0);
+        tail_.store(0);
+        dropPending_.store(false);
+        isActive_.store(true);
+    }
+
+    // Producer side. Blocks while the queue is full, returns false once the queue is inactive.
+    bool Push(const T &element)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            if (!isActive_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (tail - head_.load(std::memory_order_acquire) < capacity_) {
+                break;
+            }
+            ParkUntil(popSeq_, producerWaiters_, [this, tail] {
+                return !isActive_.load() || tail - head_.load() < capacity_;
+            });
+        }
+        slots_[tail & mask_] = element;
+        tail_.store(tail + 1, std::memory_order_seq_cst);
+        Signal(pushSeq_, consumerWaiters_);
+        return true;
+    }
+
+    // Consumer side. Blocks while the queue is empty and active, returns an empty element otherwise.
+    T Pop()
+    {
+        for (;;) {
+            if (dropPending_.load(std::memory_order_acquire)) {
+                DropAll();
+                return {};
+            }
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (head != tail_.load(std::memory_order_acquire)) {
+                T element = std::move(slots_[head & mask_]);
+                slots_[head & mask_] = T();
+                head_.store(head + 1, std::memory_order_seq_cst);
+                Signal(popSeq_, producerWaiters_);
+                return element;
+            }
+            if (!isActive_.load(std::memory_order_acquire)) {
+                return {};
+            }
+            ParkUntil(pushSeq_, consumerWaiters_, [this, head] {
+                return !isActive_.load() || dropPending_.load() || head != tail_.load();
+            });
+        }
+    }
+
+    // Producer side. Blocks until the consumer has taken every queued element.
+    void WaitEmpty()
+    {
+        while (!Empty()) {
+            ParkUntil(popSeq_, producerWaiters_, [this] { return Empty(); });
+        }
+    }
+
+    // Dropping queued data is done by the consumer on its next Pop, so this is safe from any thread.
+    void SetActive(bool active, bool cleanData = true)
+    {
+        if (active) {
+            dropPending_.store(false);
+        } else if (cleanData) {
+            dropPending_.store(true);
+        }
+        isActive_.store(active);
+        Signal(pushSeq_, consumerWaiters_);
+        Signal(popSeq_, producerWaiters_);
+    }
+
+private:
+    static size_t RoundUpCapacity(size_t capacity)
+    {
+        size_t rounded = 1;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+
+    void DropAll()
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        for (; head != tail; ++head) {
+            slots_[head & mask_] = T();
+        }
+        head_.store(head, std::memory_order_seq_cst);
+        Signal(popSeq_, producerWaiters_);
+    }
+
+    template <typename Pred>
+    static void ParkUntil(std::atomic<int32_t> &seq, std::atomic<int32_t> &waiters, Pred ready)
+    {
+        int32_t expected = seq.load(std::memory_order_acquire);
+        // Push and WaitEmpty may park on the same side from different threads, so waiters are counted.
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        if (!ready()) {
+            // A peer that changed the state after the check above also bumped seq, so the wait returns at once.
+            syscall(SYS_futex, reinterpret_cast<int32_t *>(&seq), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    static void Signal(std::atomic<int32_t> &seq, std::atomic<int32_t> &waiters)
+    {
+        seq.fetch_add(1, std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_seq_cst) > 0) {
+            syscall(SYS_futex, reinterpret_cast<int32_t *>(&seq), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+        }
+    }
+
+    std::string name_;
+    size_t capacity_ = 0;
+    size_t mask_ = 0;
+    std::vector<T> slots_;
+    alignas(Detail::RING_QUEUE_CACHE_LINE) std::atomic<size_t> head_ = 0;
+    alignas(Detail::RING_QUEUE_CACHE_LINE) std::atomic<size_t> tail_ = 0;
+    alignas(Detail::RING_QUEUE_CACHE_LINE) std::atomic<int32_t> pushSeq_ = 0;
+    std::atomic<int32_t> consumerWaiters_ = 0;
+    alignas(Detail::RING_QUEUE_CACHE_LINE) std::atomic<int32_t> popSeq_ = 0;
+    std::atomic<int32_t> producerWaiters_ = 0;
+    alignas(Detail::RING_QUEUE_CACHE_LINE) std::atomic<bool> isActive_ = true;
+    std::atomic<bool> dropPending_ = false;
+};
+} // namespace Media
+} // namespace OHOS
+#endif // UTILS_SPSC_RING_QUEUE_H